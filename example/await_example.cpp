@@ -0,0 +1,24 @@
+#include <bbb/promise.hpp>
+
+#include <atomic>
+
+int main(int argc, char *argv[]) {
+	// 64 continuations of one parent are queued in batches; the first one awaits a promise
+	// which only its neighbour in the same batch settles.
+	auto pool = bbb::thread_pool::create(4);
+	bbb::promise<void>::defer signal(bbb::promise<void>::create_pending(pool));
+	auto parent = bbb::promise<int>::create_pending(pool);
+	std::atomic<int> sum(0);
+	std::vector<bbb::promise<void>::ref> children;
+	for(int i = 0; i < 64; ++i) {
+		children.push_back(parent->then([i, signal, &sum](int x) {
+			if(i == 0) bbb::await(signal.target);
+			if(i == 1) signal.resolve();
+			sum += x;
+		}));
+	}
+	bbb::promise<int>::defer(parent).resolve(1);
+	for(auto &child : children) bbb::await(child);
+	std::cout << "sum " << sum << std::endl;
+	return sum == 64 ? 0 : 1;
+}
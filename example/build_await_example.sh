@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ await_example.cpp -o await_example.o -I../include/ -std=c++11 -pthread && ./await_example.o
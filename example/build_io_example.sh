@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ io_example.cpp -o io_example.o -I../include/ -std=c++11 -pthread && ./io_example.o
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ loadgen.cpp -o bbb_promise_loadgen -I../include/ -std=c++11 -pthread -O2 -Dbbb_promise_debug_flag=0 && ./bbb_promise_loadgen "$@"
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ parallel_example.cpp -o parallel_example.o -I../include/ -std=c++11 -pthread && ./parallel_example.o
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ run_loop_example.cpp -o run_loop_example.o -I../include/ -std=c++11 -pthread && ./run_loop_example.o
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ simulation_example.cpp -o simulation_example.o -I../include/ -std=c++11 -pthread && ./simulation_example.o
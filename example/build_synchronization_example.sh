@@ -0,0 +1,3 @@
+#!/bin/bash
+
+g++ synchronization_example.cpp -o synchronization_example.o -I../include/ -std=c++11 -pthread && ./synchronization_example.o
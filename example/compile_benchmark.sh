@@ -0,0 +1,57 @@
+#!/bin/bash
+
+# measures compile time and binary size of a translation unit with many distinct chains.
+# usage: CHAINS=500 ./compile_benchmark.sh [extra compiler flags]
+# INCLUDE=path/to/other/include compares against another version of the header.
+# CSV=path/to/results.csv appends the results there (commit, chains, flags, mode, seconds, bytes).
+
+CXX=${CXX:-g++}
+CHAINS=${CHAINS:-200}
+INCLUDE=${INCLUDE:-../include/}
+CSV=${CSV:-}
+FLAGS="-std=c++11 -pthread -O2 -Dbbb_promise_debug_flag=0 $*"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+{
+	echo '#include <bbb/promise.hpp>'
+	echo 'int chains() {'
+	echo '	int sum = 0;'
+	for i in $(seq 1 $CHAINS); do
+		echo "	sum += bbb::create_promise([] { return $i; })"
+		echo "		->then([](int x) { return std::to_string(x + $i); })"
+		echo "		->then([](std::string s) { return s.size() + $i; }, [](std::exception_ptr) { return std::size_t($i); })"
+		echo "		->then([](std::size_t n) { if(n == $i) throw std::runtime_error(\"$i\"); })"
+		echo "		->except([](std::exception_ptr) {})"
+		echo "		->then([] { return $i; })"
+		echo "		->await();"
+	done
+	echo '	return sum;'
+	echo '}'
+} > "$WORK/chains.cpp"
+echo 'int chains(); int main() { return chains() == 0; }' > "$WORK/main.cpp"
+echo '#define bbb_promise_instantiate_templates' > "$WORK/instantiate.cpp"
+echo '#include <bbb/promise.hpp>' >> "$WORK/instantiate.cpp"
+
+# times the compilation of the chains alone, as the other translation units are built once in a real project.
+measure() {
+	local mode=$1
+	shift
+	$CXX $FLAGS -I"$INCLUDE" "$@" -c "$WORK/main.cpp" -o "$WORK/main.o" || exit 1
+	$CXX $FLAGS -I"$INCLUDE" "$@" -c "$WORK/instantiate.cpp" -o "$WORK/instantiate.o" || exit 1
+	local start=$(date +%s.%N)
+	$CXX $FLAGS -I"$INCLUDE" "$@" -c "$WORK/chains.cpp" -o "$WORK/chains.o" || exit 1
+	local end=$(date +%s.%N)
+	$CXX $FLAGS "$WORK/chains.o" "$WORK/main.o" "$WORK/instantiate.o" -o "$WORK/bench.o" || exit 1
+	local seconds=$(awk "BEGIN { print $end - $start }")
+	local bytes=$(stat -c %s "$WORK/bench.o")
+	local text=$(size "$WORK/bench.o" | awk 'NR == 2 { print $1 }')
+	printf "%-16s %8.2fs %10d bytes (text %d)\n" "$mode" "$seconds" "$bytes" "$text"
+	if [ -n "$CSV" ]; then
+		echo "$(git rev-parse --short HEAD 2>/dev/null),$CHAINS,\"$FLAGS\",$mode,$seconds,$bytes" >> "$CSV"
+	fi
+}
+
+echo "$CHAINS chains, $CXX $FLAGS"
+measure header_only
+measure extern_templates -Dbbb_promise_extern_templates=1
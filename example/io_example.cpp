@@ -0,0 +1,52 @@
+#include <bbb/promise.hpp>
+
+#include <cstring>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+int main(int argc, char *argv[]) {
+	auto io = bbb::io::reactor::create();
+
+	// socketpair: the read is pending until the other end writes
+	int fds[2];
+	::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	char buf[64] = {0};
+	auto read = io->async_read(fds[0], buf, sizeof(buf));
+	io->async_write(fds[1], "hello", 5);
+	std::cout << "read " << bbb::await(read) << " bytes: " << std::string(buf, 5) << std::endl;
+
+	// loopback echo server: accept -> read -> write back
+	int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	::bind(listener, reinterpret_cast<sockaddr *>(&addr), len);
+	::listen(listener, 16);
+	::getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &len);
+
+	// server side: each step continues on the pool once the reactor saw the fd ready
+	auto echo_buf = std::make_shared<std::vector<char>>(64);
+	auto served = io->async_accept(listener)
+		->then([io, echo_buf](int conn) {
+			std::size_t n = bbb::await(io->async_read(conn, echo_buf->data(), echo_buf->size()));
+			n = bbb::await(io->async_write(conn, echo_buf->data(), n));
+			::close(conn);
+			return n;
+		});
+
+	int client = ::socket(AF_INET, SOCK_STREAM, 0);
+	::connect(client, reinterpret_cast<sockaddr *>(&addr), len);
+	char reply[64] = {0};
+	bbb::await(io->async_write(client, "ping", 4));
+	std::size_t n = bbb::await(io->async_read(client, reply, sizeof(reply)));
+	std::cout << "echo: " << std::string(reply, n) << std::endl;
+	std::cout << "server echoed " << bbb::await(served) << " bytes" << std::endl;
+
+	::close(client);
+	::close(listener);
+	::close(fds[0]);
+	::close(fds[1]);
+	return 0;
+}
@@ -0,0 +1,232 @@
+// bbb_promise_loadgen: sustained mixed load on a thread_pool, scaled from 1 worker thread to all cores.
+// usage: ./bbb_promise_loadgen [--duration=2] [--depth=4] [--fanout=4] [--reject=0.01] [--payload=64]
+//                              [--producers=2] [--inflight=64] [--max-threads=<cores>]
+
+#include <bbb/promise.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace std::chrono;
+
+struct config {
+	double duration = 2.0;
+	std::size_t depth = 4;
+	// parallel branches joined in the middle of each chain, 0 or 1 disables the fan-out.
+	std::size_t fanout = 4;
+	// probability that a chain is rejected, at one of its stages or fan-out branches picked at random.
+	double reject = 0.01;
+	std::size_t payload = 64;
+	std::size_t producers = 2;
+	// chains kept pending per producer.
+	std::size_t inflight = 64;
+	std::size_t max_threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+};
+
+static config parse(int argc, char *argv[]) {
+	config c;
+	for(int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		std::size_t eq = arg.find('=');
+		if(arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+			std::cerr << "unknown argument " << arg << std::endl;
+			std::exit(1);
+		}
+		std::string key = arg.substr(2, eq - 2);
+		const char *value = arg.c_str() + eq + 1;
+		if(key == "duration") c.duration = std::atof(value);
+		else if(key == "depth") c.depth = std::strtoul(value, nullptr, 10);
+		else if(key == "fanout") c.fanout = std::strtoul(value, nullptr, 10);
+		else if(key == "reject") c.reject = std::atof(value);
+		else if(key == "payload") c.payload = std::strtoul(value, nullptr, 10);
+		else if(key == "producers") c.producers = std::max<std::size_t>(1, std::strtoul(value, nullptr, 10));
+		else if(key == "inflight") c.inflight = std::max<std::size_t>(1, std::strtoul(value, nullptr, 10));
+		else if(key == "max-threads") c.max_threads = std::max<std::size_t>(1, std::strtoul(value, nullptr, 10));
+		else {
+			std::cerr << "unknown argument " << arg << std::endl;
+			std::exit(1);
+		}
+	}
+	return c;
+}
+
+static std::size_t num_threads_now() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while(std::getline(status, line)) {
+		if(line.compare(0, 8, "Threads:") == 0) return std::strtoul(line.c_str() + 8, nullptr, 10);
+	}
+	return 0;
+}
+
+static long peak_rss_kb() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+// one stage of work: touches the whole payload.
+static std::string stage(std::string payload, std::size_t salt, bool fail) {
+	if(fail) throw std::runtime_error("rejected");
+	for(auto &c : payload) c = static_cast<char>(c * 31 + salt);
+	return payload;
+}
+
+static bool has_fan_out(const config &c)
+{ return 0 < c.depth && 1 < c.fanout; }
+
+// no stage fails if the chain isn't rejected.
+static const std::size_t no_failure = static_cast<std::size_t>(-1);
+
+using chain_ref = bbb::promise<std::int64_t>::ref;
+
+// joins the branches like bbb::all would, for a fan-out width only known at run time.
+// branch failing_branch (if any) throws.
+static bbb::promise<std::string>::ref fan_out(bbb::promise<std::string>::ref parent, const config &c, std::size_t failing_branch) {
+	struct join {
+		join(std::size_t n, bbb::promise<std::string>::defer d) : remaining(n), failed(false), d(std::move(d)) {};
+		std::atomic<std::size_t> remaining;
+		std::atomic<bool> failed;
+		bbb::promise<std::string>::defer d;
+	};
+	bbb::promise<std::string>::defer d(bbb::promise<std::string>::create_pending(parent->get_executor()));
+	auto j = std::make_shared<join>(c.fanout, d);
+	for(std::size_t i = 0; i < c.fanout; ++i) {
+		bool fail = i == failing_branch;
+		parent
+			->then([i, fail](std::string payload) { return stage(std::move(payload), i, fail); })
+			->then([j](std::string payload) {
+				if(--j->remaining == 0) j->d.resolve(std::move(payload));
+			}, [j](std::exception_ptr err_ptr) {
+				if(!j->failed.exchange(true)) j->d.reject(err_ptr);
+			}, bbb::inline_executor());
+	}
+	return d.target;
+}
+
+// resolves the end-to-end latency in ns, negated if the chain was rejected.
+static chain_ref make_chain(bbb::executor::ref pool, const config &c, std::mt19937 &random) {
+	auto start = steady_clock::now();
+	// positions 0 .. depth - 1 are the stages, the fan-out branches follow.
+	std::size_t num_positions = c.depth + (has_fan_out(c) ? c.fanout : 0);
+	std::size_t failing = no_failure;
+	if(std::uniform_real_distribution<double>()(random) < c.reject) {
+		failing = num_positions == 0 ? 0 : std::uniform_int_distribution<std::size_t>(0, num_positions - 1)(random);
+	}
+	std::string payload(c.payload, 'x');
+	bool source_fails = num_positions == 0 && failing != no_failure;
+	auto p = bbb::create_promise([payload, source_fails] { return stage(payload, 0, source_fails); }, pool);
+	for(std::size_t i = 0; i < c.depth; ++i) {
+		if(i == c.depth / 2 && has_fan_out(c)) {
+			p = fan_out(p, c, failing != no_failure && c.depth <= failing ? failing - c.depth : no_failure);
+		}
+		bool fail = i == failing;
+		p = p->then([i, fail](std::string payload) { return stage(std::move(payload), i, fail); });
+	}
+	return p->then([start](std::string) {
+		return static_cast<std::int64_t>(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+	}, [start](std::exception_ptr) {
+		return -static_cast<std::int64_t>(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+	});
+}
+
+struct result {
+	std::size_t threads;
+	double ops_per_sec;
+	double p50, p99, p999;
+	double rejected;
+	long peak_rss_kb;
+	std::size_t peak_threads;
+};
+
+static result run(std::size_t threads, const config &c) {
+	auto pool = bbb::thread_pool::create(threads);
+	std::atomic<bool> stop(false);
+	std::vector<std::vector<std::int64_t>> latencies(c.producers);
+
+	std::atomic<std::size_t> peak_threads(num_threads_now());
+	std::thread sampler([&stop, &peak_threads] {
+		while(!stop) {
+			std::size_t n = num_threads_now();
+			if(peak_threads < n) peak_threads = n;
+			std::this_thread::sleep_for(milliseconds(10));
+		}
+	});
+
+	auto start = steady_clock::now();
+	std::vector<std::thread> producers;
+	for(std::size_t i = 0; i < c.producers; ++i) {
+		producers.emplace_back([i, &c, &pool, &stop, &latencies] {
+			std::mt19937 random(static_cast<std::mt19937::result_type>(i + 1));
+			std::deque<chain_ref> pending;
+			while(!stop) {
+				pending.push_back(make_chain(pool, c, random));
+				if(c.inflight <= pending.size()) {
+					latencies[i].push_back(bbb::await(pending.front()));
+					pending.pop_front();
+				}
+			}
+			for(auto &p : pending) latencies[i].push_back(bbb::await(p));
+		});
+	}
+	std::this_thread::sleep_for(duration<double>(c.duration));
+	stop = true;
+	for(auto &producer : producers) producer.join();
+	double elapsed = duration<double>(steady_clock::now() - start).count();
+	sampler.join();
+
+	std::vector<std::int64_t> all;
+	std::size_t rejected = 0;
+	for(auto &l : latencies) {
+		for(auto ns : l) {
+			if(ns < 0) ++rejected;
+			all.push_back(ns < 0 ? -ns : ns);
+		}
+	}
+	std::sort(all.begin(), all.end());
+	auto percentile = [&all](double q) {
+		if(all.empty()) return 0.0;
+		return all[std::min(all.size() - 1, static_cast<std::size_t>(q * all.size()))] / 1000.0;
+	};
+
+	result r;
+	r.threads = threads;
+	r.ops_per_sec = all.size() / elapsed;
+	r.p50 = percentile(0.5);
+	r.p99 = percentile(0.99);
+	r.p999 = percentile(0.999);
+	r.rejected = all.empty() ? 0.0 : 100.0 * rejected / all.size();
+	r.peak_rss_kb = peak_rss_kb();
+	r.peak_threads = peak_threads;
+	return r;
+}
+
+int main(int argc, char *argv[]) {
+	config c = parse(argc, argv);
+	std::printf("depth %zu, fanout %zu, reject %.3f, payload %zuB, producers %zu, inflight %zu, %.1fs per step\n",
+		c.depth, c.fanout, c.reject, c.payload, c.producers, c.inflight, c.duration);
+	std::printf("%8s %12s %10s %10s %10s %9s %12s %13s\n",
+		"threads", "ops/s", "p50(us)", "p99(us)", "p999(us)", "rejected", "peak rss(MB)", "peak threads");
+
+	std::vector<std::size_t> steps;
+	for(std::size_t n = 1; n < c.max_threads; n *= 2) steps.push_back(n);
+	steps.push_back(c.max_threads);
+	for(std::size_t threads : steps) {
+		result r = run(threads, c);
+		// ru_maxrss is the peak of the whole process so far, it never goes down between steps.
+		std::printf("%8zu %12.0f %10.1f %10.1f %10.1f %8.2f%% %12.1f %13zu\n",
+			r.threads, r.ops_per_sec, r.p50, r.p99, r.p999, r.rejected, r.peak_rss_kb / 1024.0, r.peak_threads);
+	}
+	return 0;
+}
@@ -0,0 +1,27 @@
+#include <bbb/promise.hpp>
+
+#include <numeric>
+
+int main(int argc, char *argv[]) {
+	std::vector<double> values(1000000);
+	std::iota(values.begin(), values.end(), 0.0);
+	
+	auto squares = bbb::parallel_map(values.begin(), values.end(), [](double x) {
+		return x * x;
+	});
+	std::cout << "squares[999]: " << bbb::await(squares)[999] << std::endl;
+	
+	auto sum = bbb::map_reduce(std::move(values), [](double x) {
+		return x;
+	}, [](double a, double b) {
+		return a + b;
+	});
+	std::cout << "sum: " << bbb::await(sum) << std::endl;
+	
+	std::vector<int> counts(16);
+	bbb::await(bbb::parallel_for(0, 16, [&counts](int i) {
+		counts[i] = i * 2;
+	}, 4));
+	std::cout << "counts[15]: " << counts[15] << std::endl;
+	return 0;
+}
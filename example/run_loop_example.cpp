@@ -0,0 +1,25 @@
+#include <bbb/promise.hpp>
+
+int main(int argc, char *argv[]) {
+	auto main_loop = bbb::run_loop::create();
+	bool finished = false;
+	
+	bbb::create_promise([] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		return 42;
+	})
+		->then([&finished](int x) {
+			// runs on the main thread, inside main_loop->poll
+			std::cout << "result on main thread: " << x << std::endl;
+			finished = true;
+		}, main_loop);
+	
+	std::size_t frames = 0;
+	while(!finished) {
+		main_loop->poll(std::chrono::milliseconds(2));
+		std::this_thread::sleep_for(std::chrono::milliseconds(16));
+		++frames;
+	}
+	std::cout << "frames: " << frames << std::endl;
+	return 0;
+}
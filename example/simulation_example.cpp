@@ -0,0 +1,43 @@
+#include <bbb/promise.hpp>
+
+#include <algorithm>
+
+using namespace std::chrono;
+
+int main(int argc, char *argv[]) {
+	auto sim = bbb::manual_executor::create();
+	sim->set_tracing(true);
+	auto real_start = steady_clock::now();
+
+	// 1000 requests arriving every 100us: fetch (io, 2-20ms) -> parse (cpu, 200us) -> store (io, 5ms)
+	const int num_requests = 1000;
+	std::vector<steady_clock::duration> latencies(num_requests);
+	for(int i = 0; i < num_requests; ++i) {
+		bbb::delay(microseconds(100 * i), sim)->then([sim, i, &latencies] {
+			auto arrival = sim->now();
+			bbb::delay(milliseconds(2 + (i * 7919) % 19), sim)->then([sim, i, arrival, &latencies] {
+				sim->annotate("parse");
+				sim->spend(microseconds(200));
+				bbb::delay(milliseconds(5), sim)->then([sim, i, arrival, &latencies] {
+					latencies[i] = sim->now() - arrival;
+				});
+			});
+		});
+	}
+	auto end = sim->run_until_idle();
+
+	std::sort(latencies.begin(), latencies.end());
+	auto ms = [](steady_clock::duration d) { return duration<double, std::milli>(d).count(); };
+	std::cout << "simulated " << ms(end.time_since_epoch()) << "ms in "
+		<< ms(steady_clock::now() - real_start) << "ms real time" << std::endl;
+	std::cout << "latency p50 " << ms(latencies[num_requests / 2])
+		<< "ms, p99 " << ms(latencies[num_requests * 99 / 100]) << "ms" << std::endl;
+
+	// the parse stage queues behind the others on the single simulated worker
+	steady_clock::duration worst_queue{};
+	for(const auto &r : sim->get_trace()) {
+		if(r.label == "parse") worst_queue = std::max(worst_queue, r.queued());
+	}
+	std::cout << "worst parse queueing " << ms(worst_queue) << "ms" << std::endl;
+	return 0;
+}
@@ -0,0 +1,56 @@
+#include <bbb/promise.hpp>
+
+#include <atomic>
+
+int main(int argc, char *argv[]) {
+	auto pool = bbb::thread_pool::create(4);
+
+	// at most 2 of 8 jobs hold a permit at once
+	auto semaphore = bbb::async_semaphore::create(2);
+	std::atomic<int> running(0), peak(0);
+	std::vector<bbb::promise<void>::ref> jobs;
+	for(int i = 0; i < 8; ++i) {
+		jobs.push_back(semaphore->acquire(pool)->then([&running, &peak](bbb::async_semaphore::permit permit) {
+			int now = ++running;
+			int seen = peak;
+			while(seen < now && !peak.compare_exchange_weak(seen, now)) {}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			--running;
+			// returns the permit now, although the promise acquire() returned still holds a copy
+			permit.release();
+		}));
+	}
+	for(auto &job : jobs) bbb::await(job);
+	std::cout << "semaphore: peak " << peak << ", available " << semaphore->available() << std::endl;
+
+	// increments in asynchronous critical sections
+	auto mutex = bbb::async_mutex::create();
+	int counter = 0;
+	std::vector<bbb::promise<void>::ref> sections;
+	for(int i = 0; i < 100; ++i) {
+		sections.push_back(mutex->lock(pool)->then([&counter](bbb::async_mutex::guard guard) {
+			++counter;
+			guard.release();
+		}));
+	}
+	for(auto &section : sections) bbb::await(section);
+	std::cout << "mutex: counter " << counter << ", unlocked " << static_cast<bool>(mutex->try_lock()) << std::endl;
+
+	// at most 3 queries pending at once, the rest queue up without blocking a thread
+	std::atomic<int> pending(0), pending_peak(0);
+	auto query = bbb::limit(3, [pool, &pending, &pending_peak](int x) {
+		int now = ++pending;
+		int seen = pending_peak;
+		while(seen < now && !pending_peak.compare_exchange_weak(seen, now)) {}
+		return bbb::delay(std::chrono::milliseconds(5), pool)->then([x, &pending] {
+			--pending;
+			return x * x;
+		});
+	});
+	std::vector<bbb::promise<int>::ref> results;
+	for(int i = 0; i < 12; ++i) results.push_back(query(i));
+	int sum = 0;
+	for(auto &result : results) sum += bbb::await(result);
+	std::cout << "limit: sum " << sum << ", peak pending " << pending_peak << std::endl;
+	return 0;
+}
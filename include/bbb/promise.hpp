@@ -9,18 +9,32 @@
 #include <functional>
 #include <memory>
 #include <list>
+#include <thread>
 
 #include <bbb/core.hpp>
 #include <bbb/integer_sequence.hpp>
 #include <bbb/function_traits.hpp>
 
-#define bbb_promise_debug_flag 1
+#ifndef bbb_promise_debug_flag
+#	define bbb_promise_debug_flag 1
+#endif
 
 #include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
 #include <bbb/promise/base_promise.hpp>
 #include <bbb/promise/promise_void.hpp>
 #include <bbb/promise/promise.hpp>
+#include <bbb/promise/instantiations.hpp>
 #include <bbb/promise/utility.hpp>
+#include <bbb/promise/run_loop.hpp>
+#include <bbb/promise/numa.hpp>
+#include <bbb/promise/manual_executor.hpp>
+#include <bbb/promise/parallel.hpp>
+#include <bbb/promise/memoize.hpp>
+#include <bbb/promise/synchronization.hpp>
+#include <bbb/promise/retry.hpp>
+#include <bbb/promise/loop.hpp>
+#include <bbb/promise/reactor.hpp>
 
 #if bbb_promise_debug_flag
 #	include <iostream>
@@ -3,39 +3,270 @@
 #ifndef bbb_promise_base_promise_hpp
 #define bbb_promise_base_promise_hpp
 
-#include <list>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
 
 #include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+
+// upper bound of sizeof(promise<void>) and sizeof(promise<void *>), checked by static_assert.
+// it bounds the promise object only: make_shared puts its control block in the same allocation
+// (16 more bytes on common 64 bit standard libraries) and doesn't align it to a cache line, so no claim about cache lines is made.
+#ifndef bbb_promise_node_size_budget
+#	define bbb_promise_node_size_budget 64
+#endif
 
 namespace bbb {
+	namespace promise_detail {
+		template <typename promise_type>
+		struct defer_handle;
+	};
+
+	// layout: the hot fields (state, continuation list) follow the shared_ptr control block and the weak this
+	// in the same allocation, the value / error is stored in place by the derived promise right after ex.
+	// a promise doesn't own anything else: callbacks live in the continuation tasks, which are destroyed right after they ran.
 	struct base_promise : std::enable_shared_from_this<base_promise> {
 		using ref = std::shared_ptr<base_promise>;
-		base_promise::ref parent;
-		base_promise::ref self;
-		
-		template <typename promise_ref>
-		promise_ref setup_promise(promise_ref p) {
-			p->parent = shared_from_this();
-			p->self = p;
-			return p;
+		using continuation = executor::task;
+
+		base_promise(scheduling s)
+		: state(state_type::pending)
+		, level(s.level)
+		, num_defers(0)
+		, continuations(nullptr)
+		, ex(s.ex ? std::move(s.ex) : default_promise_executor())
+		{};
+
+		~base_promise() {
+			continuation_node *n = continuations.load(std::memory_order_acquire);
+			if(n == closed()) return;
+			while(n) {
+				continuation_node *next = n->next;
+				delete n;
+				n = next;
+			}
+		};
+
+		bool is_settled() const {
+			return state_type::settling < state.load(std::memory_order_acquire);
 		}
-		void finish_process() {
-			if(parent) {
-				parent->suicide();
-				parent.reset();
+
+		const executor::ref &get_executor() const
+		{ return ex; };
+
+		priority get_priority() const
+		{ return level; };
+
+		// scheduling of a child: unset fields of s are taken from this promise.
+		scheduling inherit(const scheduling &s) const
+		{ return s.inherit(ex, level); };
+
+		// posts c to continuation_ex once this promise is settled (immediately if it already is).
+		void on_settle(executor::ref continuation_ex, continuation c, priority p = priority::normal) {
+			continuation_node *n = continuations.load(std::memory_order_acquire);
+			if(n != closed()) {
+				continuation_node *node = new continuation_node(std::move(continuation_ex), p, std::move(c));
+				node->next = n;
+				while(!continuations.compare_exchange_weak(node->next, node, std::memory_order_acq_rel, std::memory_order_acquire)) {
+					if(node->next == closed()) {
+						continuation_ex = std::move(node->ex);
+						c = std::move(node->c);
+						delete node;
+						continuation_ex->post(std::move(c), p);
+						return;
+					}
+				}
+				return;
 			}
-			self.reset();
+			continuation_ex->post(std::move(c), p);
 		}
-		void suicide() {
-			self.reset();
+
+		// blocks the calling thread until this promise is settled.
+		// on a worker of an executor which supports it, the executor keeps its work progressing meanwhile (see help_until).
+		void wait() {
+			if(is_settled()) return;
+			// the reference keeps the executor alive until the notification below has run.
+			executor::ref helper = executor::current_ref();
+			if(helper) {
+				auto done = std::make_shared<bool>(false);
+				on_settle(inline_executor(), [helper, done] {
+					helper->notify_helpers([&done] { *done = true; });
+				});
+				if(helper->help_until([&done] { return *done; })) return;
+			}
+
+			struct latch {
+				std::mutex mutex;
+				std::condition_variable condition;
+				bool done = false;
+			};
+			auto l = std::make_shared<latch>();
+			on_settle(inline_executor(), [l] {
+				std::lock_guard<std::mutex> lock(l->mutex);
+				l->done = true;
+				l->condition.notify_all();
+			});
+			std::unique_lock<std::mutex> lock(l->mutex);
+			l->condition.wait(lock, [&l] { return l->done; });
+		}
+
+	protected:
+		enum class state_type : std::uint8_t {
+			pending,
+			settling,
+			resolved,
+			rejected
+		};
+
+		// returns false if this promise was already settled; first settlement wins.
+		bool begin_settle() {
+			state_type expected = state_type::pending;
+			return state.compare_exchange_strong(expected, state_type::settling, std::memory_order_acquire);
 		}
+
+		// call exactly once after a successful begin_settle, once the value or error has been stored.
+		void settle(state_type result) {
+			state.store(result, std::memory_order_release);
+			continuation_node *n = continuations.exchange(closed(), std::memory_order_acq_rel);
+			// the list is LIFO; reverse it so continuations are posted in registration order.
+			continuation_node *ordered = nullptr;
+			while(n) {
+				continuation_node *next = n->next;
+				n->next = ordered;
+				ordered = n;
+				n = next;
+			}
+			// consecutive continuations for the same executor and priority are handed over as one bulk.
+			while(ordered) {
+				continuation_node *last = ordered;
+				std::size_t run = 1;
+				while(last->next && last->next->ex == ordered->ex && last->next->level == ordered->level) {
+					last = last->next;
+					++run;
+				}
+				continuation_node *next = last->next;
+				if(run == 1) {
+					ordered->ex->post(std::move(ordered->c), ordered->level);
+					delete ordered;
+				} else {
+					executor::ref bulk_ex = ordered->ex;
+					priority bulk_level = ordered->level;
+					std::vector<continuation> bulk;
+					bulk.reserve(run);
+					while(ordered != next) {
+						continuation_node *n = ordered->next;
+						bulk.push_back(std::move(ordered->c));
+						delete ordered;
+						ordered = n;
+					}
+					bulk_ex->post_bulk(std::move(bulk), bulk_level);
+				}
+				ordered = next;
+			}
+		}
+
+		state_type get_state() const
+		{ return state.load(std::memory_order_acquire); };
+
+		std::atomic<state_type> state;
+		priority level;
+
+	private:
+		template <typename promise_type>
+		friend struct promise_detail::defer_handle;
+
+		void retain_defer()
+		{ num_defers.fetch_add(1, std::memory_order_relaxed); };
+
+		// true for the last defer.
+		bool release_defer()
+		{ return num_defers.fetch_sub(1, std::memory_order_acq_rel) == 1; };
+
+		// fills the padding after state and level.
+		std::atomic<std::uint32_t> num_defers;
+
+		struct continuation_node {
+			continuation_node(executor::ref ex, priority level, continuation c)
+			: next(nullptr)
+			, level(level)
+			, ex(std::move(ex))
+			, c(std::move(c))
+			{};
+			continuation_node *next;
+			priority level;
+			executor::ref ex;
+			continuation c;
+		};
+
+		// sentinel marking a settled promise's list: nothing can be appended any more.
+		static continuation_node *closed()
+		{ return reinterpret_cast<continuation_node *>(static_cast<std::uintptr_t>(1)); };
+
+		std::atomic<continuation_node *> continuations;
+
+	protected:
+		executor::ref ex;
 	};
-	
+
 	template <typename promise_ref>
 	inline static promise_ref init_promise(promise_ref p) {
 		return p;
 	}
+
+	namespace promise_detail {
+		inline std::exception_ptr broken_promise_error()
+		{ return std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)); };
+
+		// the part of a defer which owns target. copies are counted in the promise: when the last one goes away
+		// while target is still pending, nothing can settle it any more and it is rejected with broken_promise.
+		template <typename promise_type>
+		struct defer_handle {
+			defer_handle(std::shared_ptr<promise_type> target)
+			: target(std::move(target))
+			{ retain(); };
+			defer_handle(const defer_handle &other)
+			: target(other.target)
+			{ retain(); };
+			defer_handle(defer_handle &&other)
+			: target(std::move(other.target)) {};
+			~defer_handle()
+			{ release(); };
+
+			defer_handle &operator=(const defer_handle &other) {
+				if(this == &other) return *this;
+				release();
+				target = other.target;
+				retain();
+				return *this;
+			}
+
+			defer_handle &operator=(defer_handle &&other) {
+				if(this == &other) return *this;
+				release();
+				target = std::move(other.target);
+				return *this;
+			}
+
+			std::shared_ptr<promise_type> target;
+
+		private:
+			void retain() {
+				if(target) target->retain_defer();
+			}
+
+			void release() {
+				if(target && target->release_defer()) target->reject(broken_promise_error());
+			}
+		};
+	};
 };
 
 #endif
@@ -0,0 +1,166 @@
+#pragma once
+
+#ifndef bbb_promise_chainable_hpp
+#define bbb_promise_chainable_hpp
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <bbb/core.hpp>
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+
+namespace bbb {
+	namespace promise_detail {
+		template <typename ...>
+		struct make_void
+		{ using type = void; };
+		template <typename ... types>
+		using void_t = typename make_void<types ...>::type;
+
+		// result of calling a callback with the value of a promise<argument_type>. no member if it can't be called.
+		template <typename function_type, typename argument_type, typename = void>
+		struct callback_result {};
+		template <typename function_type, typename argument_type>
+		struct callback_result<function_type, argument_type, void_t<decltype(std::declval<function_type &>()(std::declval<const argument_type &>()))>>
+		{ using type = typename std::decay<decltype(std::declval<function_type &>()(std::declval<const argument_type &>()))>::type; };
+		template <typename function_type>
+		struct callback_result<function_type, void, void_t<decltype(std::declval<function_type &>()())>>
+		{ using type = typename std::decay<decltype(std::declval<function_type &>()())>::type; };
+
+		template <typename function_type, typename argument_type>
+		using callback_result_t = typename callback_result<function_type, argument_type>::type;
+
+		// settles d with the result of f().
+		template <typename result_type>
+		struct settle_with {
+			template <typename defer_type, typename function_type>
+			static void run(const defer_type &d, function_type &&f)
+			{ d.resolve(f()); };
+		};
+
+		template <>
+		struct settle_with<void> {
+			template <typename defer_type, typename function_type>
+			static void run(const defer_type &d, function_type &&f) {
+				f();
+				d.resolve();
+			};
+		};
+
+		// callback type of a promise<argument_type>'s then: the value is passed by const reference.
+		template <typename new_result_type, typename argument_type>
+		struct value_callback
+		{ using type = std::function<new_result_type(const argument_type &)>; };
+		template <typename new_result_type>
+		struct value_callback<new_result_type, void>
+		{ using type = std::function<new_result_type()>; };
+
+		// then / except, shared by promise<T> and promise<void>.
+		// callbacks are converted to std::function at the boundary, so the continuation code is instantiated
+		// once per pair of value types, not once per callback type.
+		template <typename promise_type, typename result_type>
+		struct chainable {
+			// each of then / except takes an optional executor and / or priority (see bbb::scheduling); unset ones are inherited.
+			template <typename function_type>
+			auto then(function_type callback, scheduling s = scheduling())
+				-> typename promise<callback_result_t<function_type, result_type>>::ref
+			{
+				using new_result_type = callback_result_t<function_type, result_type>;
+				return then_impl<new_result_type>(
+					typename value_callback<new_result_type, result_type>::type(std::move(callback)),
+					nullptr,
+					std::move(s)
+				);
+			}
+
+			template <
+				typename function_type,
+				typename error_callback_type,
+				typename = callback_result_t<error_callback_type, std::exception_ptr>
+			>
+			auto then(function_type callback, error_callback_type error_callback, scheduling s = scheduling())
+				-> typename promise<callback_result_t<function_type, result_type>>::ref
+			{
+				using new_result_type = callback_result_t<function_type, result_type>;
+				return then_impl<new_result_type>(
+					typename value_callback<new_result_type, result_type>::type(std::move(callback)),
+					std::function<new_result_type(std::exception_ptr)>(std::move(error_callback)),
+					std::move(s)
+				);
+			}
+
+			template <
+				typename function_type,
+				typename = callback_result_t<function_type, std::exception_ptr>
+			>
+			auto except(function_type callback, scheduling s = scheduling())
+				-> std::shared_ptr<promise_type>
+			{ return except_impl(std::function<result_type(std::exception_ptr)>(std::move(callback)), std::move(s)); };
+
+		private:
+			// without error_callback, errors are passed on to the result.
+			template <typename new_result_type>
+			typename promise<new_result_type>::ref then_impl(
+				typename value_callback<new_result_type, result_type>::type callback,
+				std::function<new_result_type(std::exception_ptr)> error_callback,
+				scheduling s
+			) {
+				using new_promise = promise<new_result_type>;
+				typename new_promise::defer d(new_promise::create_pending(self().inherit(s)));
+				typename promise_type::ref parent = self().shared_this();
+				self().on_settle(d.target->get_executor(), [callback, error_callback, d, parent] {
+					try {
+						settle_with<new_result_type>::run(d, [&] {
+							return parent->call_with_value(callback);
+						});
+					} catch(...) {
+						std::exception_ptr err_ptr = std::current_exception();
+						if(!error_callback) {
+							d.reject(err_ptr);
+							return;
+						}
+						try {
+							settle_with<new_result_type>::run(d, [&] {
+								return error_callback(err_ptr);
+							});
+						} catch(...) {
+							d.reject(std::current_exception());
+						}
+					}
+				}, d.target->get_priority());
+				return d.target;
+			}
+
+			std::shared_ptr<promise_type> except_impl(std::function<result_type(std::exception_ptr)> callback, scheduling s) {
+				typename promise_type::defer d(promise_type::create_pending(self().inherit(s)));
+				typename promise_type::ref parent = self().shared_this();
+				self().on_settle(d.target->get_executor(), [callback, d, parent] {
+					try {
+						settle_with<result_type>::run(d, [&] {
+							return parent->get();
+						});
+					} catch(...) {
+						try {
+							std::exception_ptr err_ptr = std::current_exception();
+							settle_with<result_type>::run(d, [&] {
+								return callback(err_ptr);
+							});
+						} catch(...) {
+							d.reject(std::current_exception());
+						}
+					}
+				}, d.target->get_priority());
+				return d.target;
+			}
+
+			promise_type &self()
+			{ return static_cast<promise_type &>(*this); };
+		};
+	};
+};
+
+#endif
@@ -0,0 +1,571 @@
+#pragma once
+
+#ifndef bbb_promise_executor_hpp
+#define bbb_promise_executor_hpp
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#	include <sched.h>
+#endif
+
+namespace bbb {
+	enum class priority : std::uint8_t {
+		low,
+		normal,
+		high
+	};
+	static constexpr std::size_t num_priorities = 3;
+
+	// executors are always owned by an executor::ref (delayed tasks keep their executor alive).
+	struct executor : std::enable_shared_from_this<executor> {
+		using ref = std::shared_ptr<executor>;
+		using task = std::function<void()>;
+		using clock = std::chrono::steady_clock;
+
+		virtual ~executor() {};
+		// executors which don't distinguish priorities simply ignore p.
+		virtual void post(task t, priority p = priority::normal) = 0;
+		virtual std::size_t concurrency() const { return 1; };
+		// posts tasks which became ready together, in order. executors may run several of them back-to-back
+		// as one queued task to save queue operations and wakeups; by default they are posted one by one.
+		virtual void post_bulk(std::vector<task> tasks, priority p = priority::normal) {
+			for(auto &t : tasks) post(std::move(t), p);
+		}
+
+		// posts t after delay without occupying a thread meanwhile; by default through bbb::timer_queue::shared().
+		virtual void post_after(clock::duration delay, task t, priority p = priority::normal);
+
+		// called on a worker of this executor that has to block until done() holds, so the executor can keep its work
+		// progressing meanwhile (by running it on this thread or by adding a worker).
+		// done() is only re-checked after a task or a notify_helpers call. returns false if not supported.
+		virtual bool help_until(const std::function<bool()> &) { return false; };
+		// applies update, which makes some done() hold, and wakes the workers blocked in help_until.
+		virtual void notify_helpers(const std::function<void()> &update) { update(); };
+
+		// executor whose worker thread the caller is, or nullptr.
+		static executor *&current() {
+			static thread_local executor *ex = nullptr;
+			return ex;
+		}
+
+		// current() kept alive, or nullptr if there is none or it is being destroyed.
+		static ref current_ref() {
+			executor *ex = current();
+			if(!ex) return nullptr;
+			try {
+				return ex->shared_from_this();
+			} catch(const std::bad_weak_ptr &) {
+				return nullptr;
+			}
+		}
+	};
+
+	// where and how urgently a promise callback runs. unset fields are inherited from the parent promise.
+	struct scheduling {
+		scheduling()
+		: ex()
+		, level(priority::normal)
+		, has_priority(false)
+		{};
+		scheduling(std::nullptr_t)
+		: scheduling() {};
+		template <typename executor_type>
+		scheduling(std::shared_ptr<executor_type> ex)
+		: ex(std::move(ex))
+		, level(priority::normal)
+		, has_priority(false)
+		{};
+		scheduling(priority level)
+		: ex()
+		, level(level)
+		, has_priority(true)
+		{};
+		template <typename executor_type>
+		scheduling(std::shared_ptr<executor_type> ex, priority level)
+		: ex(std::move(ex))
+		, level(level)
+		, has_priority(true)
+		{};
+
+		scheduling inherit(const executor::ref &parent_ex, priority parent_level) const {
+			scheduling s = *this;
+			if(!s.ex) s.ex = parent_ex;
+			if(!s.has_priority) s.level = parent_level;
+			s.has_priority = true;
+			return s;
+		}
+
+		executor::ref ex;
+		priority level;
+		bool has_priority;
+	};
+
+	// runs tasks immediately on the posting thread.
+	struct inline_executor_type : executor {
+		virtual void post(task t, priority = priority::normal) override {
+			try {
+				t();
+			} catch(...) {}
+		}
+	};
+
+	inline executor::ref inline_executor() {
+		static executor::ref *ex = new executor::ref(std::make_shared<inline_executor_type>());
+		return *ex;
+	}
+
+	// spawns a detached thread per task, so tasks may block freely.
+	struct new_thread_executor : executor {
+		virtual void post(task t, priority = priority::normal) override {
+			std::thread([](task t) {
+				try {
+					t();
+				} catch(...) {}
+			}, std::move(t)).detach();
+		}
+
+		virtual std::size_t concurrency() const override
+		{ return std::max<std::size_t>(1, std::thread::hardware_concurrency()); };
+	};
+
+	struct thread_pool_options {
+		// 0: one per cpu in cpus, or hardware_concurrency if cpus is empty.
+		std::size_t num_threads = 0;
+		std::size_t starvation_limit = 16;
+		// see thread_pool::post_bulk. 1 disables batching.
+		std::size_t batch_size = 32;
+		// workers started on top of num_threads to replace ones blocked in await, see thread_pool::help_until.
+		std::size_t max_extra_threads = 64;
+		// the workers are pinned to this cpu set (linux only). empty leaves them to the os.
+		std::vector<std::size_t> cpus;
+
+		// inclusive, e.g. cpu_range(0, 15).
+		static std::vector<std::size_t> cpu_range(std::size_t first, std::size_t last) {
+			std::vector<std::size_t> cpus;
+			for(std::size_t cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+			return cpus;
+		}
+	};
+
+	// restricts the calling thread to cpus. returns false if that isn't supported or failed.
+	inline bool pin_current_thread(const std::vector<std::size_t> &cpus) {
+#if defined(__linux__)
+		if(cpus.empty()) return false;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(std::size_t cpu : cpus) if(cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+		return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+		(void)cpus;
+		return false;
+#endif
+	}
+
+	// serves higher priorities first. a non-empty level passed over starvation_limit times in a row is served next,
+	// so low priority work keeps progressing at (at least) 1 / (starvation_limit + 1) of the throughput.
+	// post_bulk groups up to batch_size tasks into one queue entry, but never into fewer entries than workers.
+	// a worker blocked in await is replaced by an extra worker until it resumes (up to max_extra_threads of them).
+	struct thread_pool : executor {
+		using ref = std::shared_ptr<thread_pool>;
+
+		inline static ref create(std::size_t num_threads = 0, std::size_t starvation_limit = 16, std::size_t batch_size = 32) {
+			return std::make_shared<thread_pool>(num_threads, starvation_limit, batch_size);
+		}
+
+		inline static ref create(thread_pool_options options) {
+			return std::make_shared<thread_pool>(std::move(options));
+		}
+
+		thread_pool(std::size_t num_threads = 0, std::size_t starvation_limit = 16, std::size_t batch_size = 32)
+		: thread_pool(make_options(num_threads, starvation_limit, batch_size)) {};
+
+		thread_pool(thread_pool_options options)
+		: state(std::make_shared<shared_state>(this, resolve_num_threads(options), options.max_extra_threads, std::max<std::size_t>(1, options.starvation_limit), options.cpus))
+		, batch_size(std::max<std::size_t>(1, options.batch_size))
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			for(std::size_t i = 0; i < state->num_threads; ++i) spawn(state);
+		};
+
+		// queued tasks are still run; returns once all workers have exited.
+		virtual ~thread_pool() {
+			// the last reference may be dropped by a task of this pool: its worker carries on with the shared state only.
+			std::size_t self = executor::current() == this ? 1 : 0;
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->stopped = true;
+			state->condition.notify_all();
+			state->waiters.notify_all();
+			state->waiters.wait(lock, [this, self] { return state->running <= self; });
+			if(self) executor::current() = nullptr;
+		};
+
+		virtual void post(task t, priority p = priority::normal) override {
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->tasks[static_cast<std::size_t>(p)].push_back(std::move(t));
+			}
+			state->condition.notify_one();
+		}
+
+		virtual void post_bulk(std::vector<task> ts, priority p = priority::normal) override {
+			std::size_t num_tasks = ts.size();
+			if(num_tasks <= 1 || batch_size == 1) {
+				executor::post_bulk(std::move(ts), p);
+				return;
+			}
+			std::size_t num_batches = std::max(
+				(num_tasks + batch_size - 1) / batch_size,
+				std::min(num_tasks, state->num_threads)
+			);
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				auto &level = state->tasks[static_cast<std::size_t>(p)];
+				for(std::size_t i = 0; i < num_batches; ++i) {
+					std::size_t begin = i * num_tasks / num_batches;
+					std::size_t end = (i + 1) * num_tasks / num_batches;
+					if(end - begin == 1) {
+						level.push_back(std::move(ts[begin]));
+						continue;
+					}
+					batch b(state.get(), p);
+					b.tasks.reserve(end - begin);
+					for(std::size_t j = begin; j < end; ++j) b.tasks.push_back(std::move(ts[j]));
+					level.push_back(std::move(b));
+				}
+			}
+			if(num_batches < state->num_threads) {
+				for(std::size_t i = 0; i < num_batches; ++i) state->condition.notify_one();
+			} else {
+				state->condition.notify_all();
+			}
+		}
+
+		virtual std::size_t concurrency() const override
+		{ return state->num_threads; };
+
+		std::size_t get_batch_size() const
+		{ return batch_size; };
+
+		const std::vector<std::size_t> &get_cpus() const
+		{ return state->cpus; };
+
+		// parks the calling worker and starts a replacement if the pool would otherwise run below num_threads.
+		// queued tasks aren't run on the waiting stack: one of them could wait in turn, and the first waiter
+		// couldn't resume before it even after its own promise settled.
+		// once max_extra_threads replacements run, the worker runs queued tasks itself instead, as parking it
+		// could leave nobody to run them.
+		// gives up (returns false) once the pool is stopping, the caller then blocks plainly.
+		virtual bool help_until(const std::function<bool()> &done) override {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			if(done()) return true;
+			requeue_running_batch();
+			// a surplus worker can block without a replacement.
+			if(state->running - state->blocked <= state->num_threads) {
+				if(state->num_threads + state->max_extra_threads <= state->running) return run_queued_until(lock, done);
+				spawn(state);
+			}
+			++state->blocked;
+			state->waiters.wait(lock, [this, &done] { return done() || state->stopped; });
+			--state->blocked;
+			// one worker too many now, the next one to find the queue empty retires.
+			state->condition.notify_one();
+			return done();
+		}
+
+		virtual void notify_helpers(const std::function<void()> &update) override {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			update();
+			state->waiters.notify_all();
+			// workers running queued tasks in help_until wait for tasks and for done() alike.
+			if(state->helping) state->condition.notify_all();
+		}
+
+		// extra workers currently running to replace blocked ones.
+		std::size_t num_extra_threads() const {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			return state->num_threads < state->running ? state->running - state->num_threads : 0;
+		}
+
+	private:
+		static thread_pool_options make_options(std::size_t num_threads, std::size_t starvation_limit, std::size_t batch_size) {
+			thread_pool_options options;
+			options.num_threads = num_threads;
+			options.starvation_limit = starvation_limit;
+			options.batch_size = batch_size;
+			return options;
+		}
+
+		// each task is destroyed right after it ran, so the promise (and value) it holds isn't kept until the batch ends.
+		struct batch {
+			batch(const void *owner, priority level)
+			: owner(owner)
+			, level(level)
+			, next(0)
+			{};
+
+			// tasks from next on haven't been taken yet.
+			const void *owner;
+			priority level;
+			std::vector<task> tasks;
+			std::size_t next;
+
+			void operator()() {
+				batch *outer = running();
+				running() = this;
+				while(next < tasks.size()) {
+					task t = std::move(tasks[next++]);
+					try {
+						t();
+					} catch(...) {}
+				}
+				running() = outer;
+			}
+
+			// the batch on the stack of the calling thread, innermost first.
+			static batch *&running() {
+				static thread_local batch *b = nullptr;
+				return b;
+			}
+		};
+
+		// a task of a batch about to wait in help_until puts the rest of its batch back in the queue,
+		// one of them could be what it waits for. requires mutex to be held.
+		void requeue_running_batch() {
+			batch *b = batch::running();
+			if(b == nullptr || b->owner != state.get() || b->tasks.size() <= b->next) return;
+			auto &level = state->tasks[static_cast<std::size_t>(b->level)];
+			// they were queued before anything that is queued now.
+			for(std::size_t i = b->tasks.size(); b->next < i; --i) level.push_front(std::move(b->tasks[i - 1]));
+			b->next = b->tasks.size();
+			state->condition.notify_all();
+		}
+
+		bool run_queued_until(std::unique_lock<std::mutex> &lock, const std::function<bool()> &done) {
+			++state->helping;
+			while(!done() && !state->stopped) {
+				task t;
+				if(state->pop(t)) {
+					lock.unlock();
+					try {
+						t();
+					} catch(...) {}
+					t = nullptr;
+					lock.lock();
+				} else {
+					state->condition.wait(lock);
+				}
+			}
+			--state->helping;
+			// the wakeup we consumed may have been meant for an idle worker.
+			if(state->has_tasks()) state->condition.notify_one();
+			return done();
+		}
+
+		static std::size_t resolve_num_threads(const thread_pool_options &options) {
+			if(options.num_threads != 0) return options.num_threads;
+			if(!options.cpus.empty()) return options.cpus.size();
+			return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+		}
+
+		// everything the workers touch. it is owned by them as well, so the pool may be destroyed by one of its own tasks.
+		struct shared_state {
+			shared_state(executor *self, std::size_t num_threads, std::size_t max_extra_threads, std::size_t starvation_limit, std::vector<std::size_t> cpus)
+			: self(self)
+			, num_threads(num_threads)
+			, max_extra_threads(max_extra_threads)
+			, starvation_limit(starvation_limit)
+			, cpus(std::move(cpus))
+			, running(0)
+			, blocked(0)
+			, helping(0)
+			, stopped(false)
+			{
+				skipped.fill(0);
+			};
+
+			bool has_tasks() const {
+				for(const auto &level : tasks) if(!level.empty()) return true;
+				return false;
+			}
+
+			// more workers than num_threads are free to take tasks, since a blocked one resumed.
+			bool has_surplus() const
+			{ return num_threads < running - blocked; };
+
+			// requires mutex to be held.
+			bool pop(task &t) {
+				std::size_t chosen = num_priorities;
+				for(std::size_t level = num_priorities; 0 < level--;) {
+					if(!tasks[level].empty() && starvation_limit <= skipped[level]) {
+						chosen = level;
+						break;
+					}
+				}
+				if(chosen == num_priorities) {
+					for(std::size_t level = num_priorities; 0 < level--;) {
+						if(!tasks[level].empty()) {
+							chosen = level;
+							break;
+						}
+					}
+				}
+				if(chosen == num_priorities) return false;
+				for(std::size_t level = 0; level < num_priorities; ++level) {
+					if(level != chosen && !tasks[level].empty()) ++skipped[level];
+				}
+				skipped[chosen] = 0;
+				t = std::move(tasks[chosen].front());
+				tasks[chosen].pop_front();
+				return true;
+			}
+
+			// only published as executor::current(); the pool waits for all workers before it is freed.
+			executor * const self;
+			const std::size_t num_threads;
+			const std::size_t max_extra_threads;
+			const std::size_t starvation_limit;
+			const std::vector<std::size_t> cpus;
+
+			std::mutex mutex;
+			// workers wait for tasks on condition, blocked workers and the destructor on waiters.
+			std::condition_variable condition;
+			std::condition_variable waiters;
+			std::array<std::deque<task>, num_priorities> tasks;
+			std::array<std::size_t, num_priorities> skipped;
+			// worker threads alive, how many of them are blocked in help_until and how many run queued tasks there.
+			std::size_t running;
+			std::size_t blocked;
+			std::size_t helping;
+			bool stopped;
+		};
+
+		// requires mutex to be held.
+		static void spawn(const std::shared_ptr<shared_state> &state) {
+			++state->running;
+			std::thread([state] { work(state); }).detach();
+		}
+
+		// drains the queue and returns once stopped, or as soon as it is a surplus worker.
+		static void work(std::shared_ptr<shared_state> state) {
+			if(!state->cpus.empty()) pin_current_thread(state->cpus);
+			executor::current() = state->self;
+			std::unique_lock<std::mutex> lock(state->mutex);
+			while(true) {
+				state->condition.wait(lock, [&state] { return state->stopped || state->has_tasks() || state->has_surplus(); });
+				if(state->has_surplus() && !state->stopped) break;
+				task t;
+				if(!state->pop(t)) break;
+				lock.unlock();
+				try {
+					t();
+				} catch(...) {}
+				t = nullptr;
+				lock.lock();
+			}
+			executor::current() = nullptr;
+			--state->running;
+			state->waiters.notify_all();
+		}
+
+		std::shared_ptr<shared_state> state;
+		const std::size_t batch_size;
+	};
+
+	// a single thread which posts delayed tasks to their executor once they are due.
+	struct timer_queue {
+		using clock = executor::clock;
+
+		// intentionally leaked, as default_executor.
+		static timer_queue &shared() {
+			static timer_queue *queue = new timer_queue();
+			return *queue;
+		}
+
+		timer_queue()
+		: next_sequence(0)
+		{
+			std::thread([this] { run(); }).detach();
+		};
+
+		void schedule(clock::time_point deadline, executor::ref ex, executor::task t, priority p = priority::normal) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				entries.push({ deadline, next_sequence++, std::move(ex), std::move(t), p });
+			}
+			condition.notify_one();
+		}
+
+	private:
+		struct entry {
+			clock::time_point deadline;
+			std::uint64_t sequence;
+			executor::ref ex;
+			executor::task t;
+			priority level;
+		};
+
+		// earliest deadline first, ties in scheduling order.
+		struct later {
+			bool operator()(const entry &lhs, const entry &rhs) const {
+				if(lhs.deadline != rhs.deadline) return rhs.deadline < lhs.deadline;
+				return rhs.sequence < lhs.sequence;
+			}
+		};
+
+		void run() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while(true) {
+				if(entries.empty()) {
+					condition.wait(lock);
+					continue;
+				}
+				clock::time_point deadline = entries.top().deadline;
+				if(clock::now() < deadline) {
+					condition.wait_until(lock, deadline);
+					continue;
+				}
+				entry e = std::move(const_cast<entry &>(entries.top()));
+				entries.pop();
+				lock.unlock();
+				e.ex->post(std::move(e.t), e.level);
+				e.ex.reset();
+				lock.lock();
+			}
+		}
+
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::priority_queue<entry, std::vector<entry>, later> entries;
+		std::uint64_t next_sequence;
+	};
+
+	inline void executor::post_after(clock::duration delay, task t, priority p) {
+		timer_queue::shared().schedule(clock::now() + delay, shared_from_this(), std::move(t), p);
+	}
+
+	// process-wide pool; intentionally leaked so tasks still running at exit (timers, new_thread_executor callbacks) never post into a destroyed pool.
+	inline executor::ref default_executor() {
+		static executor::ref *pool = new executor::ref(thread_pool::create());
+		return *pool;
+	}
+
+	// executor of promises created without an explicit one; their descendants inherit it.
+	// callbacks which block for long (sleep, blocking I/O) should be given a new_thread_executor instead.
+	inline executor::ref default_promise_executor() {
+		return default_executor();
+	}
+};
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef bbb_promise_instantiations_hpp
+#define bbb_promise_instantiations_hpp
+
+#include <cstdint>
+#include <string>
+
+#include <bbb/promise/promise.hpp>
+
+// compiles the members of the common promise types once instead of in every translation unit:
+// define bbb_promise_extern_templates as 1 everywhere and bbb_promise_instantiate_templates in exactly one .cpp.
+// promise<void> is a full specialization whose members are all inline, it needs neither.
+#ifndef bbb_promise_extern_templates
+#	define bbb_promise_extern_templates 0
+#endif
+
+#if defined(bbb_promise_instantiate_templates)
+#	define bbb_promise_instantiation_prefix
+#elif bbb_promise_extern_templates
+#	define bbb_promise_instantiation_prefix extern
+#endif
+
+#ifdef bbb_promise_instantiation_prefix
+namespace bbb {
+	bbb_promise_instantiation_prefix template struct promise<bool>;
+	bbb_promise_instantiation_prefix template struct promise<int>;
+	bbb_promise_instantiation_prefix template struct promise<long>;
+	bbb_promise_instantiation_prefix template struct promise<std::size_t>;
+	bbb_promise_instantiation_prefix template struct promise<double>;
+	bbb_promise_instantiation_prefix template struct promise<std::string>;
+};
+#	undef bbb_promise_instantiation_prefix
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef bbb_promise_loop_hpp
+#define bbb_promise_loop_hpp
+
+#include <memory>
+#include <utility>
+
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/promise_void.hpp>
+#include <bbb/promise/promise.hpp>
+
+namespace bbb {
+	namespace loop_detail {
+		// owns the loop: only the current iteration's promise is referenced, earlier ones are released as the next begins.
+		template <typename state_type, typename body_type, typename condition_type>
+		struct loop_state : std::enable_shared_from_this<loop_state<state_type, body_type, condition_type>> {
+			using promise_ref = typename promise<state_type>::ref;
+
+			loop_state(state_type state, body_type body, condition_type condition, typename promise<state_type>::defer d)
+			: state(std::move(state))
+			, body(std::move(body))
+			, condition(std::move(condition))
+			, d(std::move(d))
+			{};
+
+			// bodies which are settled already when they return are continued in this frame, so the stack doesn't grow.
+			void run(bool check_condition) {
+				try {
+					while(!check_condition || condition(static_cast<const state_type &>(state))) {
+						check_condition = true;
+						promise_ref p = body(static_cast<const state_type &>(state));
+						if(!p->is_settled()) {
+							continue_later(std::move(p));
+							return;
+						}
+						state = p->await();
+					}
+				} catch(...) {
+					d.reject(std::current_exception());
+					return;
+				}
+				d.resolve(std::move(state));
+			}
+
+			void continue_later(promise_ref p) {
+				auto self = this->shared_from_this();
+				// continues on the executor of the result, never inline on the thread which settled p.
+				p->then([self](state_type next) {
+					self->state = std::move(next);
+					self->run(true);
+				}, [self](std::exception_ptr err_ptr) {
+					self->d.reject(err_ptr);
+				}, d.target->get_executor());
+			}
+
+			state_type state;
+			body_type body;
+			condition_type condition;
+			typename promise<state_type>::defer d;
+		};
+
+		template <typename state_type, typename body_type, typename condition_type>
+		static typename promise<state_type>::ref start(state_type state, body_type body, condition_type condition, scheduling s, bool check_condition) {
+			typename promise<state_type>::defer d(promise<state_type>::create_pending(std::move(s)));
+			auto l = std::make_shared<loop_state<state_type, body_type, condition_type>>(
+				std::move(state),
+				std::move(body),
+				std::move(condition),
+				d
+			);
+			l->run(check_condition);
+			return d.target;
+		}
+	};
+
+	// asynchronous while loop: while condition(state) holds, state becomes the value of body(state),
+	// which returns a promise<state_type>::ref. resolves the final state, rejects with the first error.
+	// memory use is constant in the number of iterations.
+	template <typename state_type, typename body_type, typename condition_type>
+	static typename promise<state_type>::ref loop(state_type state, body_type body, condition_type condition, scheduling s = scheduling()) {
+		return loop_detail::start(std::move(state), std::move(body), std::move(condition), std::move(s), true);
+	}
+
+	// same as loop, but body runs once before condition is checked first.
+	template <typename state_type, typename body_type, typename condition_type>
+	static typename promise<state_type>::ref do_while(state_type state, body_type body, condition_type condition, scheduling s = scheduling()) {
+		return loop_detail::start(std::move(state), std::move(body), std::move(condition), std::move(s), false);
+	}
+};
+
+#endif
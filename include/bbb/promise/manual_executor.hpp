@@ -0,0 +1,310 @@
+#pragma once
+
+#ifndef bbb_promise_manual_executor_hpp
+#define bbb_promise_manual_executor_hpp
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/base_promise.hpp>
+
+namespace bbb {
+	// deterministic executor on a virtual clock: nothing runs until the owner drives it (run_one / run / advance / run_until_idle),
+	// delayed tasks (post_after, bbb::delay, bbb::retry) wait for virtual time instead of real time.
+	// it models a single worker; a task may account for work it simulates with spend().
+	// ties are broken by priority, then by posting order, so a run is reproducible.
+	struct manual_executor : executor {
+		using ref = std::shared_ptr<manual_executor>;
+		using time_point = clock::time_point;
+
+		// one executed task, in virtual time.
+		struct record {
+			std::uint64_t sequence;
+			priority level;
+			time_point posted_at;
+			time_point started_at;
+			time_point finished_at;
+			// set by the task through annotate().
+			std::string label;
+
+			clock::duration queued() const
+			{ return started_at - posted_at; };
+			clock::duration ran() const
+			{ return finished_at - started_at; };
+		};
+
+		inline static ref create() {
+			return std::make_shared<manual_executor>();
+		}
+
+		manual_executor()
+		: current_time()
+		, next_sequence(0)
+		, tracing(false)
+		, running(nullptr)
+		{};
+
+		virtual void post(task t, priority p = priority::normal) override {
+			std::lock_guard<std::mutex> lock(mutex);
+			ready[static_cast<std::size_t>(p)].push_back({ std::move(t), next_sequence++, p, current_time });
+		}
+
+		virtual void post_after(clock::duration delay, task t, priority p = priority::normal) override {
+			std::lock_guard<std::mutex> lock(mutex);
+			timers.push({ current_time + delay, next_sequence++, { std::move(t), 0, p, current_time } });
+		}
+
+		// runs queued tasks while the awaiting task waits, advancing virtual time when only timers are left.
+		// done() is read under mutex, as notify_helpers updates it from whichever thread settles the awaited promise.
+		// tasks run nested on the stack of the awaiting one, so an outer awaiting task can only resume after
+		// the inner ones returned. once nothing is left to run while an outer one could resume, the inner await
+		// throws std::errc::resource_deadlock_would_occur rather than block the driving thread for good.
+		// with nothing left and no outer task to resume, it returns false and the caller blocks until another
+		// thread settles the promise.
+		virtual bool help_until(const std::function<bool()> &done) override {
+			awaiting_scope scope(*this, done);
+			while(!holds(done)) {
+				if(run_one()) continue;
+				if(release_next_timer()) continue;
+				if(outer_can_resume()) {
+					throw std::system_error(
+						std::make_error_code(std::errc::resource_deadlock_would_occur),
+						"bbb::manual_executor: nothing left to run, an outer awaiting task can't resume before this await returns"
+					);
+				}
+				return false;
+			}
+			return true;
+		}
+
+		virtual void notify_helpers(const std::function<void()> &update) override {
+			std::lock_guard<std::mutex> lock(mutex);
+			update();
+		}
+
+		time_point now() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return current_time;
+		}
+
+		// virtual time since creation.
+		clock::duration elapsed() const
+		{ return now() - time_point(); };
+
+		// runs the next ready task. returns false if there is none; time doesn't move.
+		bool run_one() {
+			entry e;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(!pop(e)) return false;
+			}
+			execute(e);
+			return true;
+		}
+
+		// runs ready tasks, including the ones they post, until none is left. returns the number of tasks run.
+		std::size_t run() {
+			std::size_t count = 0;
+			while(run_one()) ++count;
+			return count;
+		}
+
+		// moves the clock forward by duration, running everything which becomes due on the way at its deadline.
+		std::size_t advance(clock::duration duration) {
+			time_point target = now() + duration;
+			std::size_t count = run();
+			while(release_next_timer(target)) count += run();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(current_time < target) current_time = target;
+			}
+			return count;
+		}
+
+		// runs until neither ready tasks nor timers are left. returns the virtual time at the end.
+		time_point run_until_idle() {
+			run();
+			while(release_next_timer()) run();
+			return now();
+		}
+
+		// drives until p is settled. returns false if everything ran without settling it.
+		template <typename promise_ref>
+		bool run_until(const promise_ref &p) {
+			while(!p->is_settled()) {
+				if(run_one()) continue;
+				if(!release_next_timer()) return false;
+			}
+			return true;
+		}
+
+		// advances the clock from inside a task, to model the time it takes.
+		void spend(clock::duration duration) {
+			std::lock_guard<std::mutex> lock(mutex);
+			current_time += duration;
+		}
+
+		// labels the record of the running task.
+		void annotate(std::string label) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(running) running->label = std::move(label);
+		}
+
+		std::size_t num_ready() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::size_t count = 0;
+			for(const auto &level : ready) count += level.size();
+			return count;
+		}
+
+		std::size_t num_timers() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return timers.size();
+		}
+
+		// records of the tasks run while tracing is enabled, in execution order.
+		void set_tracing(bool enabled) {
+			std::lock_guard<std::mutex> lock(mutex);
+			tracing = enabled;
+		}
+
+		std::vector<record> get_trace() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return trace;
+		}
+
+		void clear_trace() {
+			std::lock_guard<std::mutex> lock(mutex);
+			trace.clear();
+		}
+
+	private:
+		struct entry {
+			task t;
+			std::uint64_t sequence;
+			priority level;
+			time_point posted_at;
+		};
+
+		struct timer {
+			time_point deadline;
+			std::uint64_t sequence;
+			entry e;
+		};
+
+		// earliest deadline first, ties in posting order.
+		struct later {
+			bool operator()(const timer &lhs, const timer &rhs) const {
+				if(lhs.deadline != rhs.deadline) return rhs.deadline < lhs.deadline;
+				return rhs.sequence < lhs.sequence;
+			}
+		};
+
+		bool holds(const std::function<bool()> &done) const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return done();
+		}
+
+		// registers a help_until call for its duration.
+		struct awaiting_scope {
+			awaiting_scope(manual_executor &ex, const std::function<bool()> &done)
+			: ex(ex) {
+				std::lock_guard<std::mutex> lock(ex.mutex);
+				ex.awaiting.push_back(&done);
+			};
+			~awaiting_scope() {
+				std::lock_guard<std::mutex> lock(ex.mutex);
+				ex.awaiting.pop_back();
+			};
+			manual_executor &ex;
+		};
+
+		// whether an awaiting task below the innermost one has its promise settled.
+		bool outer_can_resume() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			for(std::size_t i = 0; i + 1 < awaiting.size(); ++i) {
+				if((*awaiting[i])()) return true;
+			}
+			return false;
+		}
+
+		// requires mutex to be held.
+		bool pop(entry &e) {
+			for(std::size_t level = num_priorities; 0 < level--;) {
+				if(ready[level].empty()) continue;
+				e = std::move(ready[level].front());
+				ready[level].pop_front();
+				return true;
+			}
+			return false;
+		}
+
+		// moves the clock to the earliest deadline (if not after limit) and makes all timers due then ready.
+		bool release_next_timer(time_point limit = time_point::max()) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(timers.empty() || limit < timers.top().deadline) return false;
+			time_point deadline = timers.top().deadline;
+			if(current_time < deadline) current_time = deadline;
+			while(!timers.empty() && timers.top().deadline <= current_time) {
+				timer due = std::move(const_cast<timer &>(timers.top()));
+				timers.pop();
+				due.e.sequence = next_sequence++;
+				due.e.posted_at = due.deadline;
+				ready[static_cast<std::size_t>(due.e.level)].push_back(std::move(due.e));
+			}
+			return true;
+		}
+
+		void execute(entry &e) {
+			record r;
+			bool traced;
+			// tasks run nested through help_until while an outer one awaits.
+			record *outer = nullptr;
+			executor *previous = executor::current();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				traced = tracing;
+				r.sequence = e.sequence;
+				r.level = e.level;
+				r.posted_at = e.posted_at;
+				r.started_at = current_time;
+				if(traced) {
+					outer = running;
+					running = &r;
+				}
+			}
+			executor::current() = this;
+			try {
+				e.t();
+			} catch(...) {}
+			executor::current() = previous;
+			std::lock_guard<std::mutex> lock(mutex);
+			if(!traced) return;
+			running = outer;
+			r.finished_at = current_time;
+			trace.push_back(std::move(r));
+		}
+
+		mutable std::mutex mutex;
+		std::array<std::deque<entry>, num_priorities> ready;
+		std::priority_queue<timer, std::vector<timer>, later> timers;
+		time_point current_time;
+		std::uint64_t next_sequence;
+		bool tracing;
+		record *running;
+		std::vector<record> trace;
+		// done() of the tasks awaiting in help_until, innermost last.
+		std::vector<const std::function<bool()> *> awaiting;
+	};
+};
+
+#endif
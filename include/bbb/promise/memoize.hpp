@@ -0,0 +1,215 @@
+#pragma once
+
+#ifndef bbb_promise_memoize_hpp
+#define bbb_promise_memoize_hpp
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <bbb/core.hpp>
+#include <bbb/integer_sequence.hpp>
+#include <bbb/function_traits.hpp>
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/promise_void.hpp>
+#include <bbb/promise/promise.hpp>
+#include <bbb/promise/utility.hpp>
+
+namespace bbb {
+	struct memoize_options {
+		using clock = std::chrono::steady_clock;
+
+		// number of resolved results kept after settlement, in total over all shards. 0 only deduplicates calls in flight.
+		std::size_t capacity = 0;
+		// how long a resolved result stays valid. zero keeps it until evicted by capacity.
+		clock::duration ttl = clock::duration::zero();
+		// the key space is split over this many independently locked maps (at most capacity of them if it is set).
+		std::size_t num_shards = 16;
+	};
+
+	namespace memoize_detail {
+		template <typename tuple_type, std::size_t ... indices>
+		inline std::size_t hash_tuple(const tuple_type &t, bbb::index_sequence<indices ...>) {
+			std::size_t seed = 0;
+			using expander = int[];
+			(void)expander{0, (
+				seed ^= std::hash<typename std::tuple_element<indices, tuple_type>::type>()(std::get<indices>(t))
+					+ 0x9e3779b9 + (seed << 6) + (seed >> 2),
+				0
+			) ...};
+			return seed;
+		}
+
+		template <typename tuple_type>
+		struct tuple_hash;
+		template <typename ... types>
+		struct tuple_hash<std::tuple<types ...>> {
+			std::size_t operator()(const std::tuple<types ...> &t) const
+			{ return hash_tuple(t, bbb::index_sequence_for<types ...>()); };
+		};
+	};
+
+	// wraps a promise returning function: concurrent calls with equal arguments share one promise,
+	// resolved results are optionally cached (LRU per shard, with TTL). rejected results are never kept.
+	// copies share the same cache.
+	template <typename result_type, typename ... arguments>
+	struct memoized {
+		using key_type = std::tuple<typename std::decay<arguments>::type ...>;
+		using promise_ref = typename promise<result_type>::ref;
+		using function_type = std::function<promise_ref(arguments ...)>;
+		using clock = memoize_options::clock;
+
+		memoized(function_type f, memoize_options options = memoize_options())
+		: st(std::make_shared<state>(std::move(f), options)) {};
+
+		promise_ref operator()(arguments ... args) const {
+			key_type key(args ...);
+			std::size_t hash = memoize_detail::tuple_hash<key_type>()(key);
+			shard &sh = st->shard_for(hash);
+			promise_ref p;
+			{
+				std::lock_guard<std::mutex> lock(sh.mutex);
+				auto it = sh.entries.find(key);
+				if(it != sh.entries.end()) {
+					entry &e = it->second;
+					if(!e.settled) return e.p;
+					if(st->options.ttl == clock::duration::zero() || clock::now() < e.expires_at) {
+						sh.lru.splice(sh.lru.begin(), sh.lru, e.lru_position);
+						return e.p;
+					}
+					sh.lru.erase(e.lru_position);
+					sh.entries.erase(it);
+				}
+				p = promise<result_type>::create_pending();
+				entry e;
+				e.p = p;
+				sh.entries.emplace(key, std::move(e));
+			}
+
+			// f is called outside of the lock, so it may call this memoized function again.
+			typename promise<result_type>::defer d(p);
+			std::weak_ptr<state> weak_st = st;
+			try {
+				promise_detail::forward(st->f(args ...), d, [d, weak_st, key, hash](std::exception_ptr err_ptr) {
+					if(auto s = weak_st.lock()) s->settled(key, hash, d.target, !err_ptr);
+				});
+			} catch(...) {
+				d.reject(std::current_exception());
+				st->settled(key, hash, d.target, false);
+			}
+			return p;
+		}
+
+		void clear() {
+			for(auto &sh : st->shards) {
+				std::lock_guard<std::mutex> lock(sh.mutex);
+				sh.entries.clear();
+				sh.lru.clear();
+			}
+		}
+
+		std::size_t size() const {
+			std::size_t num_entries = 0;
+			for(auto &sh : st->shards) {
+				std::lock_guard<std::mutex> lock(sh.mutex);
+				num_entries += sh.entries.size();
+			}
+			return num_entries;
+		}
+
+	private:
+		struct entry {
+			promise_ref p;
+			bool settled = false;
+			clock::time_point expires_at;
+			typename std::list<key_type>::iterator lru_position;
+		};
+
+		struct shard {
+			// resolved entries kept in this shard.
+			std::size_t capacity = 0;
+			std::mutex mutex;
+			std::unordered_map<key_type, entry, memoize_detail::tuple_hash<key_type>> entries;
+			std::list<key_type> lru;
+		};
+
+		struct state {
+			// the capacity is divided over the shards, so they keep options.capacity results together.
+			state(function_type f, memoize_options options)
+			: f(std::move(f))
+			, options(options)
+			, shards(num_shards_for(options))
+			{
+				for(std::size_t i = 0; i < shards.size(); ++i) {
+					shards[i].capacity = options.capacity / shards.size() + (i < options.capacity % shards.size() ? 1 : 0);
+				}
+			};
+
+			static std::size_t num_shards_for(const memoize_options &options) {
+				std::size_t num_shards = std::max<std::size_t>(1, options.num_shards);
+				if(options.capacity != 0) num_shards = std::min(num_shards, options.capacity);
+				return num_shards;
+			}
+
+			shard &shard_for(std::size_t hash)
+			{ return shards[(hash ^ (hash >> 16)) % shards.size()]; };
+
+			void settled(const key_type &key, std::size_t hash, const promise_ref &p, bool resolved) {
+				shard &sh = shard_for(hash);
+				std::lock_guard<std::mutex> lock(sh.mutex);
+				auto it = sh.entries.find(key);
+				// the entry may have been cleared or replaced meanwhile.
+				if(it == sh.entries.end() || it->second.p != p) return;
+				if(!resolved || sh.capacity == 0) {
+					sh.entries.erase(it);
+					return;
+				}
+				entry &e = it->second;
+				e.settled = true;
+				e.expires_at = clock::now() + options.ttl;
+				sh.lru.push_front(key);
+				e.lru_position = sh.lru.begin();
+				while(sh.capacity < sh.lru.size()) {
+					sh.entries.erase(sh.lru.back());
+					sh.lru.pop_back();
+				}
+			}
+
+			function_type f;
+			const memoize_options options;
+			std::vector<shard> shards;
+		};
+
+		std::shared_ptr<state> st;
+	};
+
+	namespace memoize_detail {
+		template <typename promise_ref, typename arguments_tuple>
+		struct memoized_type;
+		template <typename promise_ref, typename ... arguments>
+		struct memoized_type<promise_ref, std::tuple<arguments ...>> {
+			using type = memoized<unwrap_promise_ref_t<promise_ref>, arguments ...>;
+		};
+	};
+
+	template <typename function_type>
+	static auto memoize(function_type f, memoize_options options = memoize_options())
+		-> typename memoize_detail::memoized_type<
+			typename function_traits<function_type>::result_type,
+			typename function_traits<function_type>::arguments_types_tuple
+		>::type
+	{
+		using memoized_t = typename memoize_detail::memoized_type<
+			typename function_traits<function_type>::result_type,
+			typename function_traits<function_type>::arguments_types_tuple
+		>::type;
+		return memoized_t(function_traits<function_type>::cast(f), options);
+	}
+};
+
+#endif
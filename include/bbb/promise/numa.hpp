@@ -0,0 +1,157 @@
+#pragma once
+
+#ifndef bbb_promise_numa_hpp
+#define bbb_promise_numa_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#	include <dirent.h>
+#	include <sched.h>
+#endif
+
+#include <bbb/promise/executor.hpp>
+
+namespace bbb {
+	namespace numa {
+		struct node {
+			std::size_t id;
+			std::vector<std::size_t> cpus;
+		};
+
+		// parses the kernel's cpu list format, e.g. "0-3,8,10-11".
+		static std::vector<std::size_t> parse_cpu_list(const std::string &list) {
+			std::vector<std::size_t> cpus;
+			std::size_t pos = 0;
+			while(pos < list.size()) {
+				std::size_t end = list.find(',', pos);
+				if(end == std::string::npos) end = list.size();
+				std::string item = list.substr(pos, end - pos);
+				pos = end + 1;
+				if(item.empty() || item[0] < '0' || '9' < item[0]) continue;
+				std::size_t dash = item.find('-');
+				std::size_t first = std::strtoul(item.c_str(), nullptr, 10);
+				std::size_t last = dash == std::string::npos ? first : std::strtoul(item.c_str() + dash + 1, nullptr, 10);
+				for(std::size_t cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+			}
+			return cpus;
+		}
+
+		// nodes with cpus, from /sys/devices/system/node (no libnuma needed).
+		// falls back to a single node holding all cpus where that isn't available.
+		static std::vector<node> topology() {
+			std::vector<node> nodes;
+#if defined(__linux__)
+			const std::string root = "/sys/devices/system/node/";
+			if(DIR *dir = ::opendir(root.c_str())) {
+				while(dirent *entry = ::readdir(dir)) {
+					std::string name = entry->d_name;
+					if(name.compare(0, 4, "node") != 0 || name.size() == 4 || name[4] < '0' || '9' < name[4]) continue;
+					std::ifstream file(root + name + "/cpulist");
+					std::string list;
+					if(!std::getline(file, list)) continue;
+					node n;
+					n.id = std::strtoul(name.c_str() + 4, nullptr, 10);
+					n.cpus = parse_cpu_list(list);
+					// memory only nodes have no cpus to run workers on.
+					if(!n.cpus.empty()) nodes.push_back(std::move(n));
+				}
+				::closedir(dir);
+			}
+#endif
+			if(nodes.empty()) {
+				node n;
+				n.id = 0;
+				n.cpus = thread_pool_options::cpu_range(0, std::max<std::size_t>(1, std::thread::hardware_concurrency()) - 1);
+				nodes.push_back(std::move(n));
+			}
+			std::sort(nodes.begin(), nodes.end(), [](const node &lhs, const node &rhs) { return lhs.id < rhs.id; });
+			return nodes;
+		}
+	};
+
+	// one thread_pool per numa node, each pinned to the cpus of its node.
+	// a task is posted to the node of the posting thread: continuations stay on the node where their parent settled.
+	// only where tasks run is node aware. promise state isn't placed on a node, it is allocated by whichever thread
+	// calls create_promise / then, which may run on any node.
+	struct numa_pool : executor {
+		using ref = std::shared_ptr<numa_pool>;
+
+		// options.num_threads is per node (0: one per cpu of the node), options.cpus is ignored.
+		inline static ref create(thread_pool_options options = thread_pool_options()) {
+			return std::make_shared<numa_pool>(numa::topology(), std::move(options));
+		}
+
+		inline static ref create(std::vector<numa::node> nodes, thread_pool_options options = thread_pool_options()) {
+			return std::make_shared<numa_pool>(std::move(nodes), std::move(options));
+		}
+
+		numa_pool(std::vector<numa::node> nodes, thread_pool_options options)
+		: nodes(nodes.empty() ? numa::topology() : std::move(nodes))
+		, next_node(0)
+		{
+			for(std::size_t i = 0; i < this->nodes.size(); ++i) {
+				thread_pool_options node_options = options;
+				node_options.cpus = this->nodes[i].cpus;
+				pools.push_back(thread_pool::create(std::move(node_options)));
+				for(std::size_t cpu : this->nodes[i].cpus) {
+					if(node_of_cpu.size() <= cpu) node_of_cpu.resize(cpu + 1, this->nodes.size());
+					node_of_cpu[cpu] = i;
+				}
+			}
+		};
+
+		virtual void post(task t, priority p = priority::normal) override
+		{ pools[current_node()]->post(std::move(t), p); };
+
+		virtual void post_bulk(std::vector<task> tasks, priority p = priority::normal) override
+		{ pools[current_node()]->post_bulk(std::move(tasks), p); };
+
+		virtual std::size_t concurrency() const override {
+			std::size_t sum = 0;
+			for(const auto &pool : pools) sum += pool->concurrency();
+			return sum;
+		}
+
+		std::size_t num_nodes() const
+		{ return pools.size(); };
+
+		const numa::node &get_node(std::size_t index) const
+		{ return nodes[index]; };
+
+		// the pool of one node, to place work explicitly.
+		const thread_pool::ref &node_executor(std::size_t index) const
+		{ return pools[index]; };
+
+		// index of the node the calling thread runs on. threads outside of this pool whose cpu is unknown
+		// are spread over the nodes round robin.
+		std::size_t current_node() {
+			executor *current = executor::current();
+			for(std::size_t i = 0; i < pools.size(); ++i) {
+				if(pools[i].get() == current) return i;
+			}
+#if defined(__linux__)
+			int cpu = ::sched_getcpu();
+			if(0 <= cpu && static_cast<std::size_t>(cpu) < node_of_cpu.size() && node_of_cpu[cpu] < pools.size()) {
+				return node_of_cpu[cpu];
+			}
+#endif
+			return next_node.fetch_add(1, std::memory_order_relaxed) % pools.size();
+		}
+
+	private:
+		const std::vector<numa::node> nodes;
+		std::vector<thread_pool::ref> pools;
+		std::vector<std::size_t> node_of_cpu;
+		std::atomic<std::size_t> next_node;
+	};
+};
+
+#endif
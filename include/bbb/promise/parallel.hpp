@@ -0,0 +1,252 @@
+#pragma once
+
+#ifndef bbb_promise_parallel_hpp
+#define bbb_promise_parallel_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/promise_void.hpp>
+#include <bbb/promise/promise.hpp>
+
+namespace bbb {
+	namespace parallel_detail {
+		inline std::size_t chunk_size(std::size_t size, std::size_t grain_size, std::size_t concurrency) {
+			if(grain_size != 0) return grain_size;
+			// about 4 chunks per worker balances uneven chunks without per-element scheduling
+			std::size_t num_chunks = std::max<std::size_t>(1, concurrency) * 4;
+			return std::max<std::size_t>(1, (size + num_chunks - 1) / num_chunks);
+		}
+
+		struct chunk_state {
+			using body_type = std::function<void(std::size_t, std::size_t, std::size_t)>;
+
+			chunk_state(std::size_t size, std::size_t grain_size, body_type body)
+			: size(size)
+			, grain_size(grain_size)
+			, num_chunks((size + grain_size - 1) / grain_size)
+			, next_chunk(0)
+			, finished_chunks(0)
+			, failed(false)
+			, body(std::move(body))
+			{};
+
+			// claims chunks until none are left; returns when this runner has nothing more to do.
+			void run() {
+				std::size_t finished = 0;
+				while(true) {
+					std::size_t index = next_chunk.fetch_add(1);
+					if(num_chunks <= index) break;
+					if(!failed.load(std::memory_order_relaxed)) {
+						std::size_t begin = index * grain_size;
+						std::size_t end = std::min(size, begin + grain_size);
+						try {
+							body(index, begin, end);
+						} catch(...) {
+							std::lock_guard<std::mutex> lock(mutex);
+							if(!error) error = std::current_exception();
+							failed = true;
+						}
+					}
+					++finished;
+				}
+				if(finished == 0) return;
+				if(finished_chunks.fetch_add(finished) + finished == num_chunks) {
+					std::lock_guard<std::mutex> lock(mutex);
+					condition.notify_all();
+				}
+			}
+
+			void wait() {
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return finished_chunks.load() == num_chunks; });
+				if(error) std::rethrow_exception(error);
+			}
+
+			const std::size_t size;
+			const std::size_t grain_size;
+			const std::size_t num_chunks;
+			std::atomic<std::size_t> next_chunk;
+			std::atomic<std::size_t> finished_chunks;
+			std::atomic<bool> failed;
+			std::exception_ptr error;
+			std::mutex mutex;
+			std::condition_variable condition;
+			body_type body;
+		};
+
+		// splits [0, size) into chunks and runs body(chunk_index, begin, end) over them.
+		// only one task per worker is posted; the calling thread claims chunks too, so this completes even if ex is saturated.
+		inline std::size_t for_each_chunk(executor::ref ex,
+										  std::size_t size,
+										  std::size_t grain_size,
+										  chunk_state::body_type body)
+		{
+			if(size == 0) return 0;
+			grain_size = chunk_size(size, grain_size, ex->concurrency());
+			auto state = std::make_shared<chunk_state>(size, grain_size, std::move(body));
+			std::size_t num_helpers = std::min(state->num_chunks - 1, ex->concurrency());
+			for(std::size_t i = 0; i < num_helpers; ++i) {
+				ex->post([state] { state->run(); });
+			}
+			state->run();
+			state->wait();
+			return state->num_chunks;
+		}
+
+		// a chunk advances to its begin once and then steps element by element, so ranges without random access stay linear.
+		template <typename iterator>
+		inline auto position_at(iterator first, std::size_t index)
+			-> enable_if_t<!std::is_integral<iterator>::value, iterator>
+		{ return std::next(first, static_cast<typename std::iterator_traits<iterator>::difference_type>(index)); }
+
+		template <typename integer_type>
+		inline auto position_at(integer_type first, std::size_t index)
+			-> enable_if_t<std::is_integral<integer_type>::value, integer_type>
+		{ return static_cast<integer_type>(first + index); }
+
+		template <typename iterator>
+		inline auto element(const iterator &position)
+			-> enable_if_t<!std::is_integral<iterator>::value, decltype(*position)>
+		{ return *position; }
+
+		template <typename integer_type>
+		inline auto element(const integer_type &position)
+			-> enable_if_t<std::is_integral<integer_type>::value, integer_type>
+		{ return position; }
+
+		template <typename iterator>
+		inline auto range_size(iterator first, iterator last)
+			-> enable_if_t<!std::is_integral<iterator>::value, std::size_t>
+		{ return static_cast<std::size_t>(std::distance(first, last)); }
+
+		template <typename integer_type>
+		inline auto range_size(integer_type first, integer_type last)
+			-> enable_if_t<std::is_integral<integer_type>::value, std::size_t>
+		{ return first < last ? static_cast<std::size_t>(last - first) : 0; }
+
+		template <typename iterator, typename function_type>
+		inline void parallel_for(executor::ref ex, iterator first, iterator last, function_type f, std::size_t grain_size) {
+			for_each_chunk(ex, range_size(first, last), grain_size, [&](std::size_t, std::size_t begin, std::size_t end) {
+				iterator position = position_at(first, begin);
+				for(std::size_t i = begin; i < end; ++i, ++position) f(element(position));
+			});
+		}
+
+		template <typename iterator, typename function_type>
+		using map_result_t = typename std::decay<decltype(std::declval<function_type &>()(element(std::declval<const iterator &>())))>::type;
+
+		// results are collected with one addressable element per slot: std::vector<bool> packs neighbours into one word,
+		// which chunks written from different threads would race on.
+		template <typename iterator, typename function_type>
+		inline std::vector<map_result_t<iterator, function_type>> parallel_map(executor::ref ex, iterator first, iterator last, function_type f, std::size_t grain_size) {
+			using result_type = map_result_t<iterator, function_type>;
+			std::size_t size = range_size(first, last);
+			std::unique_ptr<result_type[]> slots(new result_type[size]);
+			for_each_chunk(ex, size, grain_size, [&](std::size_t, std::size_t begin, std::size_t end) {
+				iterator position = position_at(first, begin);
+				for(std::size_t i = begin; i < end; ++i, ++position) slots[i] = f(element(position));
+			});
+			return std::vector<result_type>(std::make_move_iterator(slots.get()), std::make_move_iterator(slots.get() + size));
+		}
+
+		template <typename iterator, typename map_type, typename reduce_type>
+		inline map_result_t<iterator, map_type> map_reduce(executor::ref ex, iterator first, iterator last, map_type map, reduce_type reduce, std::size_t grain_size) {
+			using result_type = map_result_t<iterator, map_type>;
+			std::size_t size = range_size(first, last);
+			if(size == 0) return result_type();
+			grain_size = chunk_size(size, grain_size, ex->concurrency());
+			// one partial per chunk, combined in chunk order so only associativity of reduce is required.
+			std::size_t num_partials = (size + grain_size - 1) / grain_size;
+			std::unique_ptr<result_type[]> partials(new result_type[num_partials]);
+			for_each_chunk(ex, size, grain_size, [&](std::size_t index, std::size_t begin, std::size_t end) {
+				iterator position = position_at(first, begin);
+				result_type acc = map(element(position));
+				for(std::size_t i = begin + 1; i < end; ++i) acc = reduce(std::move(acc), map(element(++position)));
+				partials[index] = std::move(acc);
+			});
+			result_type acc = std::move(partials[0]);
+			for(std::size_t i = 1; i < num_partials; ++i) acc = reduce(std::move(acc), std::move(partials[i]));
+			return acc;
+		}
+
+		template <typename range_type>
+		using range_iterator_t = decltype(std::begin(std::declval<range_type &>()));
+	};
+
+	// the coordinating task runs on ex as well and waits there for the chunks (claiming some itself).
+	// iterator (or integer index) versions don't copy anything: [first, last) must stay valid until the promise settles.
+
+	template <typename iterator, typename function_type>
+	static auto parallel_for(iterator first, iterator last, function_type f, std::size_t grain_size = 0, executor::ref ex = default_executor())
+		-> typename promise<void>::ref
+	{
+		return promise<void>::create([=](typename promise<void>::defer &d) {
+			parallel_detail::parallel_for(ex, first, last, f, grain_size);
+			d.resolve();
+		}, ex);
+	}
+
+	template <typename iterator, typename function_type>
+	static auto parallel_map(iterator first, iterator last, function_type f, std::size_t grain_size = 0, executor::ref ex = default_executor())
+		-> typename promise<std::vector<parallel_detail::map_result_t<iterator, function_type>>>::ref
+	{
+		using result_type = std::vector<parallel_detail::map_result_t<iterator, function_type>>;
+		return promise<result_type>::create([=](typename promise<result_type>::defer &d) {
+			d.resolve(parallel_detail::parallel_map(ex, first, last, f, grain_size));
+		}, ex);
+	}
+
+	template <typename iterator, typename map_type, typename reduce_type>
+	static auto map_reduce(iterator first, iterator last, map_type map, reduce_type reduce, std::size_t grain_size = 0, executor::ref ex = default_executor())
+		-> typename promise<parallel_detail::map_result_t<iterator, map_type>>::ref
+	{
+		using result_type = parallel_detail::map_result_t<iterator, map_type>;
+		return promise<result_type>::create([=](typename promise<result_type>::defer &d) {
+			d.resolve(parallel_detail::map_reduce(ex, first, last, map, reduce, grain_size));
+		}, ex);
+	}
+
+	// range versions take ownership of the range (pass with std::move to avoid a copy).
+
+	template <typename range_type, typename function_type>
+	static auto parallel_for(range_type range, function_type f, std::size_t grain_size = 0, executor::ref ex = default_executor())
+		-> typename promise<void>::ref
+	{
+		auto owned = std::make_shared<range_type>(std::move(range));
+		return promise<void>::create([=](typename promise<void>::defer &d) {
+			parallel_detail::parallel_for(ex, std::begin(*owned), std::end(*owned), f, grain_size);
+			d.resolve();
+		}, ex);
+	}
+
+	template <typename range_type, typename function_type>
+	static auto parallel_map(range_type range, function_type f, std::size_t grain_size = 0, executor::ref ex = default_executor())
+		-> typename promise<std::vector<parallel_detail::map_result_t<parallel_detail::range_iterator_t<range_type>, function_type>>>::ref
+	{
+		using result_type = std::vector<parallel_detail::map_result_t<parallel_detail::range_iterator_t<range_type>, function_type>>;
+		auto owned = std::make_shared<range_type>(std::move(range));
+		return promise<result_type>::create([=](typename promise<result_type>::defer &d) {
+			d.resolve(parallel_detail::parallel_map(ex, std::begin(*owned), std::end(*owned), f, grain_size));
+		}, ex);
+	}
+
+	template <typename range_type, typename map_type, typename reduce_type>
+	static auto map_reduce(range_type range, map_type map, reduce_type reduce, std::size_t grain_size = 0, executor::ref ex = default_executor())
+		-> typename promise<parallel_detail::map_result_t<parallel_detail::range_iterator_t<range_type>, map_type>>::ref
+	{
+		using result_type = parallel_detail::map_result_t<parallel_detail::range_iterator_t<range_type>, map_type>;
+		auto owned = std::make_shared<range_type>(std::move(range));
+		return promise<result_type>::create([=](typename promise<result_type>::defer &d) {
+			d.resolve(parallel_detail::map_reduce(ex, std::begin(*owned), std::end(*owned), map, reduce, grain_size));
+		}, ex);
+	}
+};
+
+#endif
@@ -5,255 +5,111 @@
 
 #include <bbb/promise/type_traits.hpp>
 #include <bbb/promise/base_promise.hpp>
+#include <bbb/promise/chainable.hpp>
 
 namespace bbb {
 	template <typename result_type>
-	struct promise : base_promise {
+	struct promise : base_promise, promise_detail::chainable<promise<result_type>, result_type> {
 		using ref = std::shared_ptr<promise>;
-		
-		struct defer {
-			defer() : promise() {};
-			defer(defer &&) = default;
-			void resolve(result_type data)
-			{ promise.set_value(data); }
-			void reject(std::exception_ptr e)
-			{ promise.set_exception(e); }
-			std::promise<result_type> promise;
+
+		// a promise whose defers are all gone before it was settled is rejected with std::future_errc::broken_promise.
+		struct defer : promise_detail::defer_handle<promise> {
+			defer(ref target) : promise_detail::defer_handle<promise>(std::move(target)) {};
+			void resolve(result_type data) const
+			{ this->target->resolve(std::move(data)); }
+			void reject(std::exception_ptr e) const
+			{ this->target->reject(e); }
 		};
-		
+
 		inline static ref create(std::function<void(defer &)> callback, bool sync = false) {
-			return init_promise(std::make_shared<promise>(callback, false));
+			return create(callback, nullptr, sync);
 		}
-		
-		promise(std::function<void(defer &)> callback, bool sync = false)
-		: callback(callback)
-		, d()
-		, future(new std::future<result_type>(d.promise.get_future()))
-		{
-			if(sync) {
+
+		// callback runs on s.ex (or bbb::default_promise_executor()) with s.level; descendants inherit both unless given their own.
+		inline static ref create(std::function<void(defer &)> callback, scheduling s, bool sync = false) {
+			defer d(create_pending(s));
+			auto run = [callback, d]() {
+				defer dd = d;
 				try {
-					callback(d);
+					callback(dd);
 				} catch(...) {
 					std::exception_ptr err_ptr = std::current_exception();
-					d.reject(err_ptr);
+					dd.reject(err_ptr);
 				}
-				finish_process();
-			} else {
-				thread = std::move(std::thread([=](defer d) {
-					try {
-						callback(d);
-					} catch(...) {
-						std::exception_ptr err_ptr = std::current_exception();
-						d.reject(err_ptr);
-					}
-					finish_process();
-				}, std::move(d)));
-				thread.detach();
+			};
+			if(sync) run();
+			else d.target->ex->post(run, d.target->level);
+			return init_promise(d.target);
+		}
+
+		// pending promise which is settled through a defer made from it.
+		inline static ref create_pending(scheduling s = scheduling()) {
+			return std::make_shared<promise>(s);
+		}
+
+		promise(scheduling s = scheduling())
+		: base_promise(std::move(s)) {};
+
+		~promise() {
+			switch(get_state()) {
+				case state_type::resolved: storage.value.~result_type(); break;
+				case state_type::rejected: storage.error.~exception_ptr(); break;
+				default: break;
 			}
-		};
-		
-		promise(promise &&) = default;
-		
-		virtual ~promise() {
 #if bbb_promise_debug_flag
 			std::cout << "destruct " << typeid(decltype(*this)).name() << std::endl;
 #endif
 		};
 
 	private:
-		template <typename new_result_type>
-		auto then_impl(std::function<new_result_type(result_type)> callback)
-			-> enable_if_t<
-				!std::is_same<new_result_type, void>::value,
-				typename promise<new_result_type>::ref
-			>
-		{
-			using new_promise = promise<new_result_type>;
-			auto future = this->future;
-			return setup_promise(std::make_shared<new_promise>(
-				[callback, future](typename new_promise::defer &d) {
-					try {
-						d.resolve(callback(future->get()));
-					} catch(...) {
-						std::exception_ptr err_ptr = std::current_exception();
-						d.reject(err_ptr);
-					}
-				}
-			));
-		}
-		
-		typename promise<void>::ref then_impl(std::function<void(result_type)> callback) {
-			using new_promise = promise<void>;
-			auto future = this->future;
-			return setup_promise(std::make_shared<new_promise>(
-				[callback, future](typename new_promise::defer &d) {
-					try {
-						callback(future->get());
-						d.resolve();
-					} catch(...) {
-						std::exception_ptr err_ptr = std::current_exception();
-						d.reject(err_ptr);
-					}
-				}
-			));
-		}
-		
-		template <typename new_result_type>
-		auto then_impl(
-			std::function<new_result_type(result_type)> callback,
-			std::function<new_result_type(std::exception_ptr)> err_callback
-		)
-			-> enable_if_t<
-				!std::is_same<new_result_type, void>::value,
-				typename promise<new_result_type>::ref
-			>
-		{
-			using new_promise = promise<new_result_type>;
-			auto future = this->future;
-			return setup_promise(std::make_shared<new_promise>(
-				[callback, err_callback, future](typename new_promise::defer &d) {
-					try {
-						d.resolve(callback(future->get()));
-					} catch(...) {
-						try {
-							std::exception_ptr err_ptr = std::current_exception();
-							d.resolve(err_callback(err_ptr));
-						} catch(...) {
-							std::exception_ptr err_ptr = std::current_exception();
-							d.reject(err_ptr);
-						}
-					}
-				}
-			));
-		}
-		
-		typename promise<void>::ref then_impl(
-			std::function<void(result_type)> callback,
-			std::function<void(std::exception_ptr)> err_callback
-		) {
-			using new_promise = promise<void>;
-			auto future = this->future;
-			return setup_promise(std::make_shared<new_promise>(
-				[callback, err_callback, future](typename new_promise::defer &d) {
-					try {
-						callback(future->get());
-						d.resolve();
-					} catch(...) {
-						try {
-							std::exception_ptr err_ptr = std::current_exception();
-							err_callback(err_ptr);
-							d.resolve();
-						} catch(...) {
-							std::exception_ptr err_ptr = std::current_exception();
-							d.reject(err_ptr);
-						}
-					}
-				}
-			));
+		friend struct promise_detail::chainable<promise<result_type>, result_type>;
+		friend struct promise_detail::defer_handle<promise>;
+
+		ref shared_this()
+		{ return std::static_pointer_cast<promise>(shared_from_this()); }
+
+		void resolve(result_type data) {
+			if(!begin_settle()) return;
+			new (&storage.value) result_type(std::move(data));
+			settle(state_type::resolved);
 		}
-		
-		auto except_impl(std::function<result_type(std::exception_ptr)> callback)
-			-> enable_if_t<
-				!std::is_same<result_type, void>::value,
-				typename promise<result_type>::ref
-			>
-		{
-			using new_promise = promise<result_type>;
-			auto future = this->future;
-			return setup_promise(std::make_shared<new_promise>(
-				[callback, future](typename new_promise::defer &d) {
-					try {
-						d.resolve(future->get());
-					} catch(...) {
-						try {
-							std::exception_ptr err_ptr = std::current_exception();
-							d.resolve(callback(err_ptr));
-						} catch(...) {
-							std::exception_ptr err_ptr = std::current_exception();
-							d.reject(err_ptr);
-						}
-					}
-				}
-			));
+
+		void reject(std::exception_ptr e) {
+			if(!begin_settle()) return;
+			new (&storage.error) std::exception_ptr(std::move(e));
+			settle(state_type::rejected);
 		}
-		
-		typename promise<void>::ref except_impl(std::function<void(std::exception_ptr)> callback) {
-			using new_promise = promise<void>;
-			auto future = this->future;
-			return setup_promise(std::make_shared<new_promise>(
-				[callback, future](typename new_promise::defer &d) {
-					try {
-						future->get();
-						d.resolve();
-					} catch(...) {
-						try {
-							std::exception_ptr err_ptr = std::current_exception();
-							callback(err_ptr);
-							d.resolve();
-						} catch(...) {
-							std::exception_ptr err_ptr = std::current_exception();
-							d.reject(err_ptr);
-						}
-					}
-				}
-			));
+
+		// only valid once settled.
+		const result_type &get() const {
+			if(get_state() == state_type::rejected) std::rethrow_exception(storage.error);
+			return storage.value;
 		}
 
-		std::function<void(defer &)> callback;
-		defer d;
-		std::shared_ptr<std::future<result_type>> future;
-		std::thread thread;
-		
-	public:
 		template <typename function_type>
-		auto then(function_type callback)
-			-> enable_if_t<
-				has_call_operator<function_type>::value,
-				decltype(then_impl(function_traits<function_type>::cast(callback)))
-			>
-		{
-			return then_impl(function_traits<function_type>::cast(callback));
-		};
-		
-		template <typename function_type, typename error_callback_type>
-		auto then(function_type callback, error_callback_type error_callback)
-			-> enable_if_t<
-				has_call_operator<function_type>::value
-				&& has_call_operator<error_callback_type>::value,
-				decltype(then_impl(
-					function_traits<function_type>::cast(callback),
-					function_traits<error_callback_type>::cast(error_callback)
-				))
-			>
-		{
-			return then_impl(
-				function_traits<function_type>::cast(callback), 
-				function_traits<error_callback_type>::cast(error_callback)
-			);
-		};
-		
-		template <typename function_type>
-		auto except(function_type callback)
-			-> enable_if_t<
-				has_call_operator<function_type>::value,
-				decltype(except_impl(function_traits<function_type>::cast(callback)))
-			>
-		{
-			return except_impl(function_traits<function_type>::cast(callback));
-		};
-		
+		auto call_with_value(const function_type &f) const
+			-> decltype(f(std::declval<const result_type &>()))
+		{ return f(get()); };
+
+		// constructed in place by resolve / reject, which of both is live is told by the state.
+		union storage_type {
+			storage_type() {};
+			~storage_type() {};
+			result_type value;
+			std::exception_ptr error;
+		} storage;
+
+	public:
 		result_type await() {
-			std::promise<result_type> p;
-			std::future<result_type> v = p.get_future();
-			
-			then([&p](result_type result){
-				p.set_value(result);
-			}, [&p](std::exception_ptr err_ptr) {
-				p.set_exception(err_ptr);
-			});
-			return v.get();
+			wait();
+			return get();
 		}
 	};
+
+	static_assert(
+		sizeof(promise<void *>) <= bbb_promise_node_size_budget,
+		"promise object with a word-sized value exceeds bbb_promise_node_size_budget"
+	);
 };
 
 #endif
@@ -0,0 +1,358 @@
+#pragma once
+
+#ifndef bbb_promise_reactor_hpp
+#define bbb_promise_reactor_hpp
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/promise_void.hpp>
+#include <bbb/promise/promise.hpp>
+
+namespace bbb {
+	namespace io {
+		// epoll based reactor: one event loop thread performs readiness driven I/O and settles the promises.
+		// continuations still run on the executor of each promise (see bbb::scheduling).
+		// file descriptors are switched to O_NONBLOCK on first use; buffers must stay valid until the promise settled.
+		// operations on one fd and direction are performed in submission order.
+		struct reactor {
+			using ref = std::shared_ptr<reactor>;
+
+			inline static ref create() {
+				return std::make_shared<reactor>();
+			}
+
+			reactor()
+			: epoll_fd(::epoll_create1(EPOLL_CLOEXEC))
+			, wake_fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+			, stopped(false)
+			{
+				if(epoll_fd < 0 || wake_fd < 0) {
+					int err = errno;
+					if(0 <= epoll_fd) ::close(epoll_fd);
+					if(0 <= wake_fd) ::close(wake_fd);
+					throw std::system_error(err, std::system_category(), "bbb::io::reactor");
+				}
+				epoll_event ev{};
+				ev.events = EPOLLIN;
+				ev.data.fd = wake_fd;
+				::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+				loop_thread = std::thread([this] { run(); });
+			};
+
+			// pending operations are rejected with ECANCELED.
+			// the last reference must not be released on the loop thread, i.e. from a continuation on inline_executor().
+			~reactor() {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopped = true;
+				}
+				wake();
+				loop_thread.join();
+				::close(wake_fd);
+				::close(epoll_fd);
+			};
+
+			// reads what is available (at least 1 byte) into buf. resolves 0 at end of file.
+			typename promise<std::size_t>::ref async_read(int fd, void *buf, std::size_t size, scheduling s = scheduling()) {
+				typename promise<std::size_t>::defer d(promise<std::size_t>::create_pending(std::move(s)));
+				submit(fd, direction::in, [fd, buf, size, d]() -> completion {
+					while(true) {
+						ssize_t n = ::read(fd, buf, size);
+						if(0 <= n) return [d, n] { d.resolve(static_cast<std::size_t>(n)); };
+						if(errno == EINTR) continue;
+						if(errno == EAGAIN || errno == EWOULDBLOCK) return nullptr;
+						return failure(d, errno, "read");
+					}
+				}, rejecter(d));
+				return d.target;
+			}
+
+			// writes all of buf, resolves the number of bytes written.
+			typename promise<std::size_t>::ref async_write(int fd, const void *buf, std::size_t size, scheduling s = scheduling()) {
+				typename promise<std::size_t>::defer d(promise<std::size_t>::create_pending(std::move(s)));
+				auto written = std::make_shared<std::size_t>(0);
+				submit(fd, direction::out, [fd, buf, size, d, written]() -> completion {
+					const char *data = static_cast<const char *>(buf);
+					while(*written < size) {
+						ssize_t n = ::send(fd, data + *written, size - *written, MSG_NOSIGNAL);
+						if(n < 0 && errno == ENOTSOCK) n = ::write(fd, data + *written, size - *written);
+						if(0 <= n) {
+							*written += static_cast<std::size_t>(n);
+							continue;
+						}
+						if(errno == EINTR) continue;
+						if(errno == EAGAIN || errno == EWOULDBLOCK) return nullptr;
+						return failure(d, errno, "write");
+					}
+					return [d, size] { d.resolve(size); };
+				}, rejecter(d));
+				return d.target;
+			}
+
+			// resolves the accepted connection, which is non-blocking and close-on-exec.
+			typename promise<int>::ref async_accept(int listen_fd, scheduling s = scheduling()) {
+				typename promise<int>::defer d(promise<int>::create_pending(std::move(s)));
+				submit(listen_fd, direction::in, [listen_fd, d]() -> completion {
+					while(true) {
+						int conn = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+						if(0 <= conn) return [d, conn] { d.resolve(conn); };
+						if(errno == EINTR || errno == ECONNABORTED) continue;
+						if(errno == EAGAIN || errno == EWOULDBLOCK) return nullptr;
+						return failure(d, errno, "accept");
+					}
+				}, rejecter(d));
+				return d.target;
+			}
+
+			typename promise<void>::ref wait_readable(int fd, scheduling s = scheduling())
+			{ return wait(fd, direction::in, POLLIN, std::move(s)); };
+
+			typename promise<void>::ref wait_writable(int fd, scheduling s = scheduling())
+			{ return wait(fd, direction::out, POLLOUT, std::move(s)); };
+
+			// rejects all pending operations on fd with ECANCELED. call before closing an fd with pending operations.
+			void cancel(int fd) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					cancellations.push_back(fd);
+				}
+				wake();
+			}
+
+		private:
+			enum class direction { in, out };
+
+			// settles the promise of a finished operation.
+			using completion = std::function<void()>;
+
+			struct operation {
+				direction dir;
+				// performs the operation if possible. returns its completion, or nullptr if it would block.
+				std::function<completion()> attempt;
+				std::function<void(std::exception_ptr)> fail;
+			};
+
+			struct fd_state {
+				std::deque<operation> ops[2];
+				std::uint32_t events = 0;
+				bool pollable = true;
+			};
+
+			static std::exception_ptr error_ptr(int err, const char *what) {
+				return std::make_exception_ptr(std::system_error(err, std::system_category(), what));
+			}
+
+			template <typename defer_type>
+			static std::function<void(std::exception_ptr)> rejecter(defer_type d) {
+				return [d](std::exception_ptr err_ptr) { d.reject(err_ptr); };
+			}
+
+			template <typename defer_type>
+			static completion failure(defer_type d, int err, const char *what) {
+				std::exception_ptr err_ptr = error_ptr(err, what);
+				return [d, err_ptr] { d.reject(err_ptr); };
+			}
+
+			typename promise<void>::ref wait(int fd, direction dir, short poll_events, scheduling s) {
+				typename promise<void>::defer d(promise<void>::create_pending(std::move(s)));
+				submit(fd, dir, [fd, poll_events, d]() -> completion {
+					pollfd p{ fd, poll_events, 0 };
+					if(::poll(&p, 1, 0) <= 0) return nullptr;
+					return [d] { d.resolve(); };
+				}, rejecter(d));
+				return d.target;
+			}
+
+			void submit(int fd, direction dir, std::function<completion()> attempt, std::function<void(std::exception_ptr)> fail) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if(!stopped) {
+						submissions.push_back(std::make_pair(fd, operation{ dir, std::move(attempt), std::move(fail) }));
+						attempt = nullptr;
+					}
+				}
+				if(attempt) fail(error_ptr(ECANCELED, "bbb::io::reactor stopped"));
+				else wake();
+			}
+
+			void wake() {
+				std::uint64_t one = 1;
+				ssize_t r = ::write(wake_fd, &one, sizeof(one));
+				(void)r;
+			}
+
+			// runs the ready operations of fd in order and updates its epoll interest.
+			// their promises are settled later by the caller: a continuation on inline_executor() may close fd
+			// (and the number be reused) before epoll and states caught up with it.
+			void process(int fd, fd_state &state, bool in_ready, bool out_ready, std::vector<completion> &finished) {
+				bool ready[2] = { in_ready, out_ready };
+				for(std::size_t i = 0; i < 2; ++i) {
+					auto &ops = state.ops[i];
+					while(!ops.empty() && (ready[i] || !state.pollable)) {
+						completion c = ops.front().attempt();
+						if(!c) break;
+						finished.push_back(std::move(c));
+						ops.pop_front();
+					}
+				}
+				update_interest(fd, state);
+			}
+
+			void update_interest(int fd, fd_state &state) {
+				std::uint32_t events = 0;
+				if(!state.ops[0].empty()) events |= EPOLLIN;
+				if(!state.ops[1].empty()) events |= EPOLLOUT;
+				if(events == state.events || !state.pollable) return;
+				epoll_event ev{};
+				ev.events = events;
+				ev.data.fd = fd;
+				if(events == 0) {
+					::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+				} else if(state.events == 0) {
+					if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno == EEXIST) {
+						::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+					}
+				} else if(::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0 && errno == ENOENT) {
+					// the fd was closed and its number reused meanwhile.
+					::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+				}
+				state.events = events;
+			}
+
+			fd_state &state_of(int fd) {
+				auto it = states.find(fd);
+				if(it != states.end()) return it->second;
+				fd_state &state = states[fd];
+				int flags = ::fcntl(fd, F_GETFL);
+				if(0 <= flags && !(flags & O_NONBLOCK)) ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+				epoll_event ev{};
+				ev.data.fd = fd;
+				// regular files can't be polled, they are always ready.
+				if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+					if(errno == EPERM) state.pollable = false;
+				} else {
+					::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+				}
+				return state;
+			}
+
+			void fail_all(fd_state &state, int err, std::vector<completion> &finished) {
+				std::exception_ptr err_ptr = error_ptr(err, "bbb::io::reactor");
+				for(auto &ops : state.ops) {
+					for(auto &op : ops) {
+						std::function<void(std::exception_ptr)> fail = std::move(op.fail);
+						finished.push_back([fail, err_ptr] { fail(err_ptr); });
+					}
+					ops.clear();
+				}
+			}
+
+			static void settle(std::vector<completion> &finished) {
+				for(auto &c : finished) c();
+				finished.clear();
+			}
+
+			void run() {
+				std::vector<epoll_event> events(64);
+				std::vector<completion> finished;
+				while(true) {
+					std::vector<std::pair<int, operation>> submitted;
+					std::vector<int> cancelled;
+					bool stopping;
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						submitted.swap(submissions);
+						cancelled.swap(cancellations);
+						stopping = stopped;
+					}
+					std::vector<int> touched;
+					for(auto &s : submitted) {
+						state_of(s.first).ops[s.second.dir == direction::in ? 0 : 1].push_back(std::move(s.second));
+						touched.push_back(s.first);
+					}
+					for(int fd : cancelled) {
+						auto it = states.find(fd);
+						if(it == states.end()) continue;
+						fail_all(it->second, ECANCELED, finished);
+						update_interest(fd, it->second);
+						states.erase(it);
+					}
+					if(stopping) {
+						for(auto &s : states) fail_all(s.second, ECANCELED, finished);
+						settle(finished);
+						return;
+					}
+					// new operations are tried right away, most sockets are ready already.
+					for(int fd : touched) {
+						auto it = states.find(fd);
+						if(it != states.end()) process(fd, it->second, true, true, finished);
+					}
+					cleanup(touched);
+					settle(finished);
+
+					int n = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+					if(n < 0) continue;
+					std::vector<int> ready;
+					for(int i = 0; i < n; ++i) {
+						int fd = events[i].data.fd;
+						if(fd == wake_fd) {
+							std::uint64_t count;
+							ssize_t r = ::read(wake_fd, &count, sizeof(count));
+							(void)r;
+							continue;
+						}
+						auto it = states.find(fd);
+						if(it == states.end()) continue;
+						std::uint32_t e = events[i].events;
+						bool failed = (e & (EPOLLERR | EPOLLHUP)) != 0;
+						process(fd, it->second, failed || (e & EPOLLIN), failed || (e & EPOLLOUT), finished);
+						ready.push_back(fd);
+					}
+					cleanup(ready);
+					settle(finished);
+				}
+			}
+
+			void cleanup(const std::vector<int> &fds) {
+				for(int fd : fds) {
+					auto it = states.find(fd);
+					if(it != states.end() && it->second.ops[0].empty() && it->second.ops[1].empty()) states.erase(it);
+				}
+			}
+
+			const int epoll_fd;
+			const int wake_fd;
+			std::mutex mutex;
+			std::vector<std::pair<int, operation>> submissions;
+			std::vector<int> cancellations;
+			bool stopped;
+			// only touched by the loop thread.
+			std::unordered_map<int, fd_state> states;
+			std::thread loop_thread;
+		};
+	};
+};
+
+#endif
+
+#endif
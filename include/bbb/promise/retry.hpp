@@ -0,0 +1,127 @@
+#pragma once
+
+#ifndef bbb_promise_retry_hpp
+#define bbb_promise_retry_hpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+
+#include <bbb/function_traits.hpp>
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/promise_void.hpp>
+#include <bbb/promise/promise.hpp>
+#include <bbb/promise/utility.hpp>
+
+namespace bbb {
+	struct retry_policy {
+		using clock = executor::clock;
+
+		// including the first one.
+		std::size_t max_attempts = 3;
+		// wait before the 2nd attempt, multiplied by multiplier for each further one and capped at max_delay.
+		clock::duration initial_delay = std::chrono::milliseconds(100);
+		double multiplier = 2.0;
+		clock::duration max_delay = std::chrono::seconds(10);
+		// fraction of each wait which is randomized: the wait is uniform in [(1 - jitter) * delay, delay].
+		// 1.0 is "full jitter", 0.0 disables it.
+		double jitter = 1.0;
+		// whether an error is worth another attempt. empty retries on any error.
+		std::function<bool(std::exception_ptr)> retry_if;
+
+		clock::duration delay_before(std::size_t attempt, double random) const {
+			double scale = std::pow(multiplier, static_cast<double>(attempt - 2));
+			double delay = std::min(
+				static_cast<double>(initial_delay.count()) * scale,
+				static_cast<double>(max_delay.count())
+			);
+			delay *= 1.0 - jitter * random;
+			return clock::duration(static_cast<clock::duration::rep>(delay));
+		}
+	};
+
+	namespace retry_detail {
+		template <typename result_type>
+		struct retry_state : std::enable_shared_from_this<retry_state<result_type>> {
+			using promise_ref = typename promise<result_type>::ref;
+
+			retry_state(std::function<promise_ref()> factory, retry_policy policy, typename promise<result_type>::defer d)
+			: factory(std::move(factory))
+			, policy(std::move(policy))
+			, d(std::move(d))
+			, attempt(0)
+			, random_engine(std::random_device()())
+			{};
+
+			void start() {
+				auto self = this->shared_from_this();
+				++attempt;
+				promise_ref p;
+				try {
+					p = factory();
+				} catch(...) {
+					failed(std::current_exception());
+					return;
+				}
+				// each attempt settles a promise of its own, only a resolved one is forwarded to d.
+				typename promise<result_type>::defer attempt_d(promise<result_type>::create_pending(inline_executor()));
+				promise_detail::forward(p, attempt_d, [self, attempt_d](std::exception_ptr err_ptr) {
+					if(err_ptr) self->failed(err_ptr);
+					else promise_detail::forward(attempt_d.target, self->d);
+				});
+			}
+
+			void failed(std::exception_ptr err_ptr) {
+				bool again = attempt < policy.max_attempts;
+				if(again && policy.retry_if) {
+					// a throwing predicate ends the retries with its own error.
+					try {
+						again = policy.retry_if(err_ptr);
+					} catch(...) {
+						d.reject(std::current_exception());
+						return;
+					}
+				}
+				if(!again) {
+					d.reject(err_ptr);
+					return;
+				}
+				auto self = this->shared_from_this();
+				// the wait is a timer on the executor of the result, the next attempt starts there.
+				d.target->get_executor()->post_after(policy.delay_before(attempt + 1, uniform(random_engine)), [self] {
+					self->start();
+				}, d.target->get_priority());
+			}
+
+			std::function<promise_ref()> factory;
+			const retry_policy policy;
+			typename promise<result_type>::defer d;
+			std::size_t attempt;
+			std::mt19937 random_engine;
+			std::uniform_real_distribution<double> uniform;
+		};
+	};
+
+	// calls factory and, while the promise it returned is rejected, calls it again after a backoff wait.
+	// the result settles like the last attempt.
+	template <typename factory_type>
+	static auto retry(factory_type factory, retry_policy policy = retry_policy(), scheduling s = scheduling())
+		-> typename function_traits<factory_type>::result_type
+	{
+		using promise_ref = typename function_traits<factory_type>::result_type;
+		using result_type = unwrap_promise_ref_t<promise_ref>;
+		typename promise<result_type>::defer d(promise<result_type>::create_pending(std::move(s)));
+		auto state = std::make_shared<retry_detail::retry_state<result_type>>(
+			function_traits<factory_type>::cast(factory),
+			std::move(policy),
+			d
+		);
+		state->start();
+		return d.target;
+	}
+};
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#ifndef bbb_promise_run_loop_hpp
+#define bbb_promise_run_loop_hpp
+
+#include <atomic>
+#include <chrono>
+
+#include <bbb/promise/executor.hpp>
+
+namespace bbb {
+	// executor drained by a single owner thread (e.g. main / render thread).
+	// post is lock-free and may be called from any thread; run_once / poll must only be called from the owner.
+	struct run_loop : executor {
+		using ref = std::shared_ptr<run_loop>;
+		using clock = std::chrono::steady_clock;
+
+		inline static ref create() {
+			return std::make_shared<run_loop>();
+		}
+
+		run_loop()
+		: head(&stub)
+		, tail(&stub)
+		, num_pending(0)
+		{};
+
+		virtual ~run_loop() {
+			node *n;
+			while((n = pop())) delete n;
+		};
+
+		// tasks run in posting order; priority is ignored.
+		virtual void post(task t, priority = priority::normal) override {
+			num_pending.fetch_add(1, std::memory_order_relaxed);
+			push(new node(std::move(t)));
+		}
+
+		// runs at most one queued task. returns false if nothing was ready.
+		bool run_once() {
+			node *n = pop();
+			if(!n) return false;
+			num_pending.fetch_sub(1, std::memory_order_relaxed);
+			try {
+				n->t();
+			} catch(...) {}
+			delete n;
+			return true;
+		}
+
+		// runs tasks until the queue is empty or max_time has elapsed, whichever comes first.
+		// the budget is checked between tasks, so a single long task can still overrun it.
+		std::size_t poll(clock::duration max_time) {
+			const clock::time_point deadline = clock::now() + max_time;
+			std::size_t num_run = 0;
+			while(run_once()) {
+				++num_run;
+				if(deadline <= clock::now()) break;
+			}
+			return num_run;
+		}
+
+		// runs the tasks queued at the time of the call; tasks they post are left for the next poll.
+		std::size_t poll() {
+			std::size_t num_ready = num_pending.load(std::memory_order_relaxed);
+			std::size_t num_run = 0;
+			while(num_run < num_ready && run_once()) ++num_run;
+			return num_run;
+		}
+
+		std::size_t size() const
+		{ return num_pending.load(std::memory_order_relaxed); };
+
+		bool empty() const
+		{ return size() == 0; };
+
+	private:
+		struct node {
+			node() : next(nullptr) {};
+			node(task t) : next(nullptr), t(std::move(t)) {};
+			std::atomic<node *> next;
+			task t;
+		};
+
+		// intrusive MPSC queue (D. Vyukov): producers only exchange head, the single consumer owns tail.
+		void push(node *n) {
+			node *prev = head.exchange(n, std::memory_order_acq_rel);
+			prev->next.store(n, std::memory_order_release);
+		}
+
+		node *pop() {
+			node *t = tail;
+			node *next = t->next.load(std::memory_order_acquire);
+			if(t == &stub) {
+				if(!next) return nullptr;
+				tail = next;
+				t = next;
+				next = next->next.load(std::memory_order_acquire);
+			}
+			if(next) {
+				tail = next;
+				return t;
+			}
+			// a producer has exchanged head but not linked yet; try again on the next call.
+			if(t != head.load(std::memory_order_acquire)) return nullptr;
+			stub.next.store(nullptr, std::memory_order_relaxed);
+			push(&stub);
+			next = t->next.load(std::memory_order_acquire);
+			if(next) {
+				tail = next;
+				return t;
+			}
+			return nullptr;
+		}
+
+		std::atomic<node *> head;
+		node *tail;
+		node stub;
+		std::atomic<std::size_t> num_pending;
+	};
+};
+
+#endif
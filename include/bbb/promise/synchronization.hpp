@@ -0,0 +1,197 @@
+#pragma once
+
+#ifndef bbb_promise_synchronization_hpp
+#define bbb_promise_synchronization_hpp
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+#include <bbb/function_traits.hpp>
+#include <bbb/promise/type_traits.hpp>
+#include <bbb/promise/executor.hpp>
+#include <bbb/promise/promise_void.hpp>
+#include <bbb/promise/promise.hpp>
+#include <bbb/promise/utility.hpp>
+
+namespace bbb {
+	// counting semaphore whose acquire doesn't block: it returns a promise resolved once a permit is available.
+	// waiters are served in FIFO order, a released permit is handed to the next waiter directly.
+	struct async_semaphore : std::enable_shared_from_this<async_semaphore> {
+		using ref = std::shared_ptr<async_semaphore>;
+
+		// releases its permit when the last copy is destroyed, or on release() of any copy:
+		// the promise acquire() returned holds a copy as long as it lives.
+		struct permit {
+			permit() {};
+			void release() {
+				if(token) token->release();
+				token.reset();
+			};
+			// false once released through any copy.
+			explicit operator bool() const
+			{ return token && !token->released; };
+		private:
+			friend struct async_semaphore;
+			// shared by all copies, returns the permit once.
+			struct releaser {
+				releaser(async_semaphore::ref semaphore)
+				: semaphore(std::move(semaphore))
+				, released(false) {};
+				~releaser()
+				{ release(); };
+				void release() {
+					if(!released.exchange(true)) semaphore->release_one();
+				}
+				async_semaphore::ref semaphore;
+				std::atomic<bool> released;
+			};
+			permit(async_semaphore::ref semaphore)
+			: token(std::make_shared<releaser>(std::move(semaphore))) {};
+			std::shared_ptr<releaser> token;
+		};
+
+		inline static ref create(std::size_t count) {
+			return std::make_shared<async_semaphore>(count);
+		}
+
+		async_semaphore(std::size_t count)
+		: count(count) {};
+
+		typename promise<permit>::ref acquire(scheduling s = scheduling()) {
+			typename promise<permit>::defer d(promise<permit>::create_pending(std::move(s)));
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(count == 0) {
+					waiters.push_back(d);
+					return d.target;
+				}
+				--count;
+			}
+			d.resolve(permit(shared_from_this()));
+			return d.target;
+		}
+
+		// returns an empty permit if none is available right now.
+		permit try_acquire() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(count == 0) return permit();
+				--count;
+			}
+			return permit(shared_from_this());
+		}
+
+		std::size_t available() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return count;
+		}
+
+		std::size_t num_waiters() const {
+			std::lock_guard<std::mutex> lock(mutex);
+			return waiters.size();
+		}
+
+	private:
+		void release_one() {
+			std::unique_lock<std::mutex> lock(mutex);
+			if(waiters.empty()) {
+				++count;
+				return;
+			}
+			typename promise<permit>::defer d = std::move(waiters.front());
+			waiters.pop_front();
+			lock.unlock();
+			d.resolve(permit(shared_from_this()));
+		}
+
+		mutable std::mutex mutex;
+		std::size_t count;
+		std::deque<typename promise<permit>::defer> waiters;
+	};
+
+	// mutual exclusion for asynchronous critical sections: the section ends when the guard is released
+	// or its last copy (including the one in the promise lock() returned) is destroyed.
+	struct async_mutex {
+		using ref = std::shared_ptr<async_mutex>;
+		using guard = async_semaphore::permit;
+
+		inline static ref create() {
+			return std::make_shared<async_mutex>();
+		}
+
+		async_mutex()
+		: semaphore(async_semaphore::create(1)) {};
+
+		typename promise<guard>::ref lock(scheduling s = scheduling())
+		{ return semaphore->acquire(std::move(s)); };
+
+		guard try_lock()
+		{ return semaphore->try_acquire(); };
+
+	private:
+		async_semaphore::ref semaphore;
+	};
+
+	// wraps a promise returning function so that at most n of the promises it returned are pending at once.
+	// excess calls are queued without blocking a thread and start in call order as earlier ones settle.
+	template <typename result_type, typename ... arguments>
+	struct limited {
+		using promise_ref = typename promise<result_type>::ref;
+		using function_type = std::function<promise_ref(arguments ...)>;
+
+		limited(std::size_t n, function_type f)
+		: semaphore(async_semaphore::create(n))
+		, f(std::make_shared<function_type>(std::move(f))) {};
+
+		promise_ref operator()(arguments ... args) const {
+			typename promise<result_type>::defer d(promise<result_type>::create_pending());
+			auto f = this->f;
+			// f starts on the executor of the returned promise, not on the thread which released the permit.
+			semaphore->acquire()->then([f, d, args ...](async_semaphore::permit permit) {
+				try {
+					// the permit is held until the promise returned by f settles.
+					promise_detail::forward((*f)(args ...), d, [permit](std::exception_ptr) {});
+				} catch(...) {
+					d.reject(std::current_exception());
+				}
+			}, d.target->get_executor());
+			return d.target;
+		}
+
+		async_semaphore::ref get_semaphore() const
+		{ return semaphore; };
+
+	private:
+		async_semaphore::ref semaphore;
+		std::shared_ptr<function_type> f;
+	};
+
+	namespace synchronization_detail {
+		template <typename promise_ref, typename arguments_tuple>
+		struct limited_type;
+		template <typename promise_ref, typename ... arguments>
+		struct limited_type<promise_ref, std::tuple<arguments ...>> {
+			using type = limited<unwrap_promise_ref_t<promise_ref>, arguments ...>;
+		};
+	};
+
+	template <typename function_type>
+	static auto limit(std::size_t n, function_type f)
+		-> typename synchronization_detail::limited_type<
+			typename function_traits<function_type>::result_type,
+			typename function_traits<function_type>::arguments_types_tuple
+		>::type
+	{
+		using limited_t = typename synchronization_detail::limited_type<
+			typename function_traits<function_type>::result_type,
+			typename function_traits<function_type>::arguments_types_tuple
+		>::type;
+		return limited_t(n, function_traits<function_type>::cast(f));
+	}
+};
+
+#endif
@@ -14,7 +14,8 @@ namespace bbb {
 		return promise<result_type>::create(
 			[=](typename promise<result_type>::defer &d) {
 				d.resolve(arg);
-			}
+			},
+			true
 		);
 	};
 		
@@ -28,7 +29,8 @@ namespace bbb {
 					std::exception_ptr err_ptr = std::current_exception();
 					d.reject(err_ptr);
 				}
-			}
+			},
+			true
 		);
 	};
 		
@@ -42,7 +44,8 @@ namespace bbb {
 					std::exception_ptr err_ptr = std::current_exception();
 					d.reject(err_ptr);
 				}
-			}
+			},
+			true
 		);
 	};
 		
@@ -56,35 +59,47 @@ namespace bbb {
 			unwrap_promise_ref_t<promise_ref>
 		>
 	{
-		using type = unwrap_promise_ref_t<promise_ref>;
-		std::promise<type> p;
-		std::future<type> v = p.get_future();
-		auto then = pr->then(
-			[&p](type result){
-				p.set_value(result);
-			}, [&p](std::exception_ptr err_ptr) {
-				p.set_exception(err_ptr);
-			}
-		);
-		auto &&res = v.get();
-		then->parent.reset();
-		then->self.reset();
-		return std::move(res);
+		return pr->await();
 	}
 		
 	static void await(typename promise<void>::ref pr) {
-		std::promise<std::uint8_t> p;
-		std::future<std::uint8_t> v = p.get_future();
-		auto then = pr->then(
-			[&p] {
-				p.set_value(0);
-			}, [&p](std::exception_ptr err_ptr) {
-				p.set_exception(err_ptr);
-			}
-		);
-		then->parent.reset();
-		then->self.reset();
+		pr->await();
 	}
+
+	namespace promise_detail {
+		// settles d like src once src is settled, then calls done (if any) with the error, null if src resolved.
+		// whatever done captures is kept alive until then.
+		template <typename result_type>
+		struct forwarder {
+			static void forward(const typename promise<result_type>::ref &src, typename promise<result_type>::defer d, std::function<void(std::exception_ptr)> done) {
+				src->then([d, done](const result_type &value) {
+					d.resolve(value);
+					if(done) done(nullptr);
+				}, [d, done](std::exception_ptr err_ptr) {
+					d.reject(err_ptr);
+					if(done) done(err_ptr);
+				}, inline_executor());
+			}
+		};
+
+		template <>
+		struct forwarder<void> {
+			static void forward(const typename promise<void>::ref &src, typename promise<void>::defer d, std::function<void(std::exception_ptr)> done) {
+				src->then([d, done] {
+					d.resolve();
+					if(done) done(nullptr);
+				}, [d, done](std::exception_ptr err_ptr) {
+					d.reject(err_ptr);
+					if(done) done(err_ptr);
+				}, inline_executor());
+			}
+		};
+
+		template <typename result_type>
+		inline void forward(const std::shared_ptr<promise<result_type>> &src, typename promise<result_type>::defer d, std::function<void(std::exception_ptr)> done = nullptr) {
+			forwarder<result_type>::forward(src, std::move(d), std::move(done));
+		}
+	};
 		
 	namespace promise_detail {
 		template <typename replacee_type>
@@ -136,29 +151,38 @@ namespace bbb {
 	};
 		
 	template <typename type>
-	static typename promise<type>::ref create_promise(std::function<void(typename promise<type>::defer &)> f) {
-		return promise<type>::create(f);
+	static typename promise<type>::ref create_promise(std::function<void(typename promise<type>::defer &)> f, scheduling s = scheduling()) {
+		return promise<type>::create(f, s);
 	}
 		
 	template <typename type>
-	static typename promise<type>::ref create_promise(std::function<type()> f) {
+	static typename promise<type>::ref create_promise(std::function<type()> f, scheduling s = scheduling()) {
 		return promise<type>::create([=](typename promise<type>::defer &defer) {
 			try {
 				defer.resolve(f());
 			} catch(...) {
 				defer.reject(std::current_exception());
 			}
-		});
+		}, s);
 	}
 		
 	template <typename function_type>
-	static auto create_promise(function_type f)
+	static auto create_promise(function_type f, scheduling s = scheduling())
 		-> enable_if_t<
 			!is_function<function_type>::value,
-			decltype(create_promise(function_traits<function_type>::cast(f)))
+			decltype(bbb::create_promise(function_traits<function_type>::cast(f), s))
 		>
 	{
-		return create_promise(function_traits<function_type>::cast(f));
+		return create_promise(function_traits<function_type>::cast(f), s);
+	}
+	
+	// resolved after duration on the executor of s; no thread sleeps meanwhile.
+	inline typename promise<void>::ref delay(executor::clock::duration duration, scheduling s = scheduling()) {
+		typename promise<void>::defer d(promise<void>::create_pending(std::move(s)));
+		d.target->get_executor()->post_after(duration, [d] {
+			d.resolve();
+		}, d.target->get_priority());
+		return d.target;
 	}
 };
 